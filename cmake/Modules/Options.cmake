@@ -39,6 +39,7 @@ add_option(PTL_USE_CLANG_TIDY "Enable running clang-tidy on" OFF ${_FEATURE})
 add_option(PTL_USE_COVERAGE "Enable code coverage" OFF ${_FEATURE})
 add_option(PTL_USE_PROFILE "Enable profiling" OFF ${_FEATURE})
 add_option(PTL_USE_ARCH "Enable architecture specific flags" OFF ${_FEATURE})
+add_option(PTL_USE_IO_URING "Enable io_uring asynchronous file I/O (Linux)" ON ${_FEATURE})
 
 if(PTL_USE_ARCH)
     add_option(PTL_USE_AVX512 "Enable AVX-512 flags (if available)" OFF ${_FEATURE})
@@ -86,6 +86,23 @@ if(PTL_USE_TBB)
 endif(PTL_USE_TBB)
 
 
+################################################################################
+#
+#        io_uring (only the kernel header is required)
+#
+################################################################################
+
+if(PTL_USE_IO_URING)
+    include(CheckIncludeFileCXX)
+    check_include_file_cxx(linux/io_uring.h PTL_HAS_IO_URING_H)
+
+    if(PTL_HAS_IO_URING_H)
+        list(APPEND ${PROJECT_NAME}_DEFINITIONS PTL_USE_IO_URING)
+    endif(PTL_HAS_IO_URING_H)
+
+endif(PTL_USE_IO_URING)
+
+
 ################################################################################
 #
 #        CUDA
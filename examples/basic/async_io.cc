@@ -0,0 +1,119 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+//
+//
+/// \file async_io.cc
+/// \brief Example showing asynchronous writes and reads of a file
+//
+
+#include "common/utils.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+//============================================================================//
+
+int
+main(int argc, char** argv)
+{
+    ConsumeParameters(argc, argv);
+
+    auto     hwthreads  = std::thread::hardware_concurrency();
+    unsigned numThreads = GetEnv<unsigned>("NUM_THREADS", hwthreads,
+                                           "Getting the number of threads");
+    uint64_t num_blocks = GetEnv<uint64_t>("NUM_BLOCKS", 64,
+                                           "Setting the number of blocks of the file");
+    uint64_t block_size = GetEnv<uint64_t>("BLOCK_SIZE", 1 << 16,
+                                           "Setting the size of a block (bytes)");
+
+    TaskRunManager* runManager = new TaskRunManager(useTBB);
+    runManager->Initialize(numThreads);
+    message(runManager);
+    TaskManager* taskManager = runManager->GetTaskManager();
+
+    // scratch file in the working directory, removed when it is closed
+    char fname[] = "async_io.XXXXXX";
+    int  fd      = mkstemp(fname);
+    if(fd < 0)
+    {
+        cerr << cprefix << "mkstemp : " << strerror(errno) << endl;
+        return EXIT_FAILURE;
+    }
+    unlink(fname);
+
+    auto fill = [](uint64_t i) { return static_cast<char>('a' + i % 26); };
+
+    Timer timer;
+    timer.Start();
+
+    // write the blocks, each filled with its own character. The buffers have to
+    // stay valid until the writes complete
+    std::vector<std::vector<char>>     wbuffers(num_blocks);
+    std::vector<std::future<intmax_t>> writes;
+    for(uint64_t i = 0; i < num_blocks; ++i)
+    {
+        wbuffers[i].assign(block_size, fill(i));
+        writes.push_back(taskManager->async_write(fd, wbuffers[i].data(), block_size,
+                                                  static_cast<int64_t>(i * block_size)));
+    }
+
+    uint64_t num_errors = 0;
+    for(auto& itr : writes)
+        if(itr.get() != static_cast<intmax_t>(block_size))
+            ++num_errors;
+
+    // read the blocks back, the continuation checks a block in the thread-pool
+    std::vector<std::vector<char>> rbuffers(num_blocks, std::vector<char>(block_size));
+    std::vector<std::future<bool>> reads;
+    for(uint64_t i = 0; i < num_blocks; ++i)
+    {
+        char* _buf = rbuffers[i].data();
+        reads.push_back(taskManager->async_read(
+            fd, _buf, block_size, static_cast<int64_t>(i * block_size),
+            [=](intmax_t _n) {
+                if(_n != static_cast<intmax_t>(block_size))
+                    return false;
+                return std::count(_buf, _buf + block_size, fill(i)) ==
+                       static_cast<std::ptrdiff_t>(block_size);
+            }));
+    }
+
+    for(auto& itr : reads)
+        if(!itr.get())
+            ++num_errors;
+
+    timer.Stop();
+    close(fd);
+
+    cout << cprefix << "wrote and read back " << num_blocks << " blocks of "
+         << block_size << " bytes ("
+         << ((taskManager->io()->using_io_uring()) ? "io_uring" : "I/O threads")
+         << ") : " << timer << endl;
+
+    int64_t     ret = static_cast<int64_t>(num_errors);
+    std::string msg = (ret == 0) ? "Successful" : "Failure of the";
+    cout << prefix << msg << " asynchronous write and read-back" << endl << endl;
+
+    delete runManager;
+
+    return ret;
+}
@@ -0,0 +1,146 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+//
+//
+/// \file event_sources.cc
+/// \brief Example showing a pipe serviced by the thread-pool as an event source
+//
+
+#include "common/utils.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+//============================================================================//
+//  read/write exactly "n" bytes of a blocking file descriptor
+//
+static bool
+read_all(int fd, void* buf, size_t n)
+{
+    char* _buf = static_cast<char*>(buf);
+    while(n > 0)
+    {
+        ssize_t _n = read(fd, _buf, n);
+        if(_n <= 0)
+            return false;
+        _buf += _n;
+        n -= static_cast<size_t>(_n);
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------//
+
+static bool
+write_all(int fd, const void* buf, size_t n)
+{
+    const char* _buf = static_cast<const char*>(buf);
+    while(n > 0)
+    {
+        ssize_t _n = write(fd, _buf, n);
+        if(_n <= 0)
+            return false;
+        _buf += _n;
+        n -= static_cast<size_t>(_n);
+    }
+    return true;
+}
+
+//============================================================================//
+
+int
+main(int argc, char** argv)
+{
+    ConsumeParameters(argc, argv);
+
+    auto     hwthreads    = std::thread::hardware_concurrency();
+    unsigned numThreads   = GetEnv<unsigned>("NUM_THREADS", hwthreads,
+                                           "Getting the number of threads");
+    uint64_t num_messages = GetEnv<uint64_t>("NUM_MESSAGES", 1000,
+                                             "Setting the number of messages");
+
+    TaskRunManager* runManager = new TaskRunManager(useTBB);
+    runManager->Initialize(numThreads);
+    message(runManager);
+    TaskManager* taskManager = runManager->GetTaskManager();
+
+    // the requests are written to "request", the handler executed in the
+    // thread-pool when "request" is readable echoes them to "reply"
+    int request[2];
+    int reply[2];
+    if(pipe(request) != 0 || pipe(reply) != 0)
+    {
+        cerr << cprefix << "pipe : " << strerror(errno) << endl;
+        return EXIT_FAILURE;
+    }
+
+    std::atomic<uint64_t> num_handled(0);
+    auto                  handler = [&](int fd, uint32_t) {
+        char    _buf[512];
+        ssize_t _n = read(fd, _buf, sizeof(_buf));
+        if(_n > 0)
+        {
+            ++num_handled;
+            write_all(reply[1], _buf, static_cast<size_t>(_n));
+        }
+    };
+
+    if(!taskManager->register_event_source(request[0], EventSources::EVENT_READ,
+                                           handler))
+    {
+        cout << cprefix << "Event sources are not available on this platform" << endl;
+        delete runManager;
+        return EXIT_SUCCESS;
+    }
+
+    Timer timer;
+    timer.Start();
+    uint64_t num_errors = 0;
+    for(uint64_t i = 0; i < num_messages; ++i)
+    {
+        uint64_t _ret = 0;
+        if(!write_all(request[1], &i, sizeof(i)) ||
+           !read_all(reply[0], &_ret, sizeof(_ret)))
+        {
+            cerr << cprefix << "pipe : " << strerror(errno) << endl;
+            ++num_errors;
+            break;
+        }
+        if(_ret != i)
+            ++num_errors;
+    }
+    timer.Stop();
+
+    taskManager->unregister_event_source(request[0]);
+    for(int fd : { request[0], request[1], reply[0], reply[1] })
+        close(fd);
+
+    cout << cprefix << num_messages << " round trips (" << num_handled.load()
+         << " handler tasks) : " << timer << endl;
+
+    int64_t     ret = static_cast<int64_t>(num_errors);
+    std::string msg = (ret == 0) ? "Successful" : "Failure of the";
+    cout << prefix << msg << " event-source round trips" << endl << endl;
+
+    delete runManager;
+
+    return ret;
+}
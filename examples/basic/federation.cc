@@ -0,0 +1,86 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+//
+//
+/// \file federation.cc
+/// \brief Example showing an idle thread-pool stealing the tasks of a busy one
+//
+
+#include "common/utils.hh"
+
+#include "PTL/ThreadData.hh"
+
+//============================================================================//
+
+int
+main(int argc, char** argv)
+{
+    ConsumeParameters(argc, argv);
+
+    auto     hwthreads  = std::thread::hardware_concurrency();
+    unsigned numThreads = GetEnv<unsigned>("NUM_THREADS", hwthreads,
+                                           "Getting the number of threads");
+    uint64_t num_tasks  = GetEnv<uint64_t>("NUM_TASKS", 256,
+                                          "Setting the number of tasks");
+    uint64_t nfib       = GetEnv<uint64_t>("FIBONACCI", 27,
+                                     "Setting the fibonacci number computed by a task");
+
+    // all the tasks are added to "busy", which has a single worker, and the idle
+    // workers of "idle" execute them. The tasks of "idle" are not stealable
+    ThreadPool* busy = new ThreadPool(1);
+    ThreadPool* idle = new ThreadPool(std::max<unsigned>(numThreads, 1));
+    busy->federate(true);
+    idle->federate(false);
+
+    std::atomic<uint64_t> num_stolen(0);
+    std::atomic<uint64_t> num_wrong_pool(0);
+    auto                  task = [&]() {
+        // a stolen task is executed in the context of the pool it belongs to
+        if(ThreadData::GetInstance()->thread_pool != busy)
+            ++num_wrong_pool;
+        if(idle->get_thread_index() >= 0)
+            ++num_stolen;
+        return fibonacci(nfib);
+    };
+
+    Timer timer;
+    timer.Start();
+    TaskGroup<uint64_t> tg([](uint64_t& lhs, uint64_t rhs) { return lhs += rhs; },
+                           busy);
+    for(uint64_t i = 0; i < num_tasks; ++i)
+        tg.run(task);
+    uint64_t sum = tg.join();
+    timer.Stop();
+
+    cout << cprefix << num_tasks << " tasks computing \"fibonacci(" << nfib
+         << ")\" : " << num_stolen.load() << " executed by the idle pool : " << timer
+         << endl;
+
+    int64_t ret = (sum != num_tasks * fibonacci(nfib)) ? 1 : 0;
+    if(num_wrong_pool.load() > 0 || num_stolen.load() == 0)
+        ++ret;
+    std::string msg = (ret == 0) ? "Successful" : "Failure of the";
+    cout << prefix << msg << " work stealing between federated pools" << endl << endl;
+
+    delete idle;
+    delete busy;
+
+    return ret;
+}
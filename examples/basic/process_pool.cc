@@ -0,0 +1,112 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+//
+//
+/// \file process_pool.cc
+/// \brief Example showing a task group of worker processes surviving a crash
+//
+
+#include "common/utils.hh"
+
+#include "PTL/ProcessPool.hh"
+
+#include <algorithm>
+#include <csignal>
+
+//============================================================================//
+//  the argument of a task: a copy is sent to the worker process, the result is
+//  written to the shared arena of the pool
+//
+struct FibonacciArgs
+{
+    uint64_t  n;
+    bool      crash;
+    uint64_t* result;
+};
+
+//----------------------------------------------------------------------------//
+
+static void
+task_fibonacci(void* _args)
+{
+    FibonacciArgs* args = static_cast<FibonacciArgs*>(_args);
+    // e.g. a native kernel given bad input, this only kills the worker process
+    if(args->crash)
+        std::raise(SIGSEGV);
+    *args->result = fibonacci(args->n);
+}
+
+//============================================================================//
+
+int
+main(int argc, char** argv)
+{
+    ConsumeParameters(argc, argv);
+
+    // the functions are registered before the pool is created (the workers
+    // inherit them)
+    int fib_id = ProcessPool::register_function(&task_fibonacci);
+
+    auto     hwthreads    = std::thread::hardware_concurrency();
+    unsigned numProcesses = GetEnv<unsigned>("NUM_PROCESSES", hwthreads,
+                                             "Getting the number of worker processes");
+    uint64_t num_tasks    = GetEnv<uint64_t>("NUM_TASKS", 32,
+                                          "Setting the number of tasks of a group");
+    uint64_t nfib         = GetEnv<uint64_t>("FIBONACCI", 25,
+                                     "Setting the fibonacci number computed by a task");
+
+    ProcessPool pool(numProcesses, num_tasks * sizeof(uint64_t));
+    uint64_t*   results = pool.allocate<uint64_t>(num_tasks);
+    uint64_t    answer  = fibonacci(nfib);
+
+    // one task of the first group crashes its worker, which is replaced, the
+    // second group runs on the replacement
+    uint64_t num_errors = 0;
+    for(uint64_t crash : { num_tasks / 2, num_tasks })
+    {
+        std::fill(results, results + num_tasks, 0);
+
+        Timer timer;
+        timer.Start();
+        ProcessTaskGroup tg(&pool);
+        for(uint64_t i = 0; i < num_tasks; ++i)
+            tg.run(fib_id, FibonacciArgs{ nfib, i == crash, results + i });
+        uint64_t nfailed = tg.join();
+        timer.Stop();
+
+        uint64_t nexpected = (crash < num_tasks) ? 1 : 0;
+        uint64_t ncorrect  = std::count(results, results + num_tasks, answer);
+        cout << cprefix << num_tasks << " tasks computing \"fibonacci(" << nfib
+             << ")\" : " << nfailed << " failed, " << ncorrect << " correct : " << timer
+             << endl;
+        if(nfailed != nexpected || ncorrect + nexpected != num_tasks)
+            ++num_errors;
+    }
+
+    cout << cprefix << "worker processes replaced: " << pool.restarts() << endl;
+    if(pool.restarts() == 0)
+        ++num_errors;
+
+    int64_t     ret = static_cast<int64_t>(num_errors);
+    std::string msg = (ret == 0) ? "Successful" : "Failure of the";
+    cout << prefix << msg << " process-pool task groups" << endl << endl;
+
+    return ret;
+}
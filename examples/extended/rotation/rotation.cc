@@ -74,7 +74,7 @@ main(int argc, char** argv)
         return src;
     };
     auto run_man = cpu_run_manager();
-    init_run_manager(run_man, std::thread::hardware_concurrency());
+    init_run_manager(run_man, Threading::GetNumberOfAvailableCores());
     auto                             tp = run_man->GetThreadPool();
     TaskGroup<std::vector<Mat>, Mat> tg(join, tp);
     int                              eInterp = GetOpenCVInterpolationMode();
@@ -0,0 +1,440 @@
+// MIT License
+//
+// Copyright (c) 2019 Jonathan R. Madsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+
+#pragma once
+
+#include "macros.hh"
+#include "typedefs.hh"
+
+//======================================================================================//
+//
+//  Checkpoints of an iterative reconstruction. Every PTL_CHECKPOINT_INTERVAL
+//  iterations a slab copies its recon into one of two snapshot buffers and a task on
+//  the blocking workers of the pool (ThreadPool::add_blocking_task) writes the
+//  snapshot while the slab keeps iterating, so the compute workers never sync the
+//  file. If the previous write of the slab has not finished, the new snapshot goes
+//  into the other buffer and is written next (a newer snapshot replaces one that is
+//  still waiting), so the iteration loop never waits on the disk.
+//
+//  File layout: a 64 byte header followed by two slots, each slot holds the
+//  completed iterations of every slab and the recon. A slab alternates between the
+//  slots and its iteration count is only written after its recon has been synced,
+//  so a crash during a write leaves the other slot of the slab valid. The slabs
+//  are restored with the partition that was checkpointed.
+//
+//======================================================================================//
+
+enum CheckpointAlgorithm : int32_t
+{
+    CHECKPOINT_MLEM = 0,
+    CHECKPOINT_SIRT = 1
+};
+
+//--------------------------------------------------------------------------------------//
+
+#if !defined(_WIN32)
+
+class ReconCheckpoint
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    struct Header
+    {
+        char    magic[8];
+        int32_t version;
+        int32_t algorithm;
+        int32_t dy;
+        int32_t nx;
+        int32_t ny;
+        int32_t num_subsets;
+        int32_t nslabs;
+        int32_t reserved[7];
+
+        static constexpr const char* checkpoint_magic() { return "PTLCKPT"; }
+    };
+
+    static_assert(sizeof(Header) == 64, "ReconCheckpoint::Header must be 64 bytes");
+
+    // the state of a slab that is shared with its write task
+    struct SlabState
+    {
+        farray_t buffer[2];
+        int      iteration[2] = { 0, 0 };
+        int      slot         = 0;      // next slot of the file to write
+        int      writing      = -1;     // buffer being written
+        int      pending      = -1;     // buffer waiting to be written
+        bool     in_flight    = false;  // a write task is running
+    };
+
+public:
+    ReconCheckpoint(const std::string& fname, int algorithm, int dy, int nx, int ny,
+                    int num_subsets)
+    : m_fname(fname)
+    , m_interval(std::max(GetEnv<int>("PTL_CHECKPOINT_INTERVAL", 1), 1))
+    {
+        memset(&m_header, 0, sizeof(Header));
+        memcpy(m_header.magic, Header::checkpoint_magic(),
+               strlen(Header::checkpoint_magic()));
+        m_header.version     = 1;
+        m_header.algorithm   = algorithm;
+        m_header.dy          = dy;
+        m_header.nx          = nx;
+        m_header.ny          = ny;
+        m_header.num_subsets = num_subsets;
+
+        m_fd = open(fname.c_str(), O_RDWR | O_CREAT, 0644);
+        if(m_fd < 0)
+            throw std::runtime_error("ReconCheckpoint : unable to open '" + fname +
+                                     "' : " + strerror(errno));
+
+        // the file is overwritten by configure() so it has to be empty (or new) or a
+        // checkpoint, e.g. passing the sinogram as the checkpoint must not destroy it
+        struct stat _stat;
+        char        _magic[sizeof(m_header.magic)];
+        if(fstat(m_fd, &_stat) != 0 ||
+           (_stat.st_size != 0 &&
+            (pread(m_fd, _magic, sizeof(_magic), 0) != sizeof(_magic) ||
+             memcmp(_magic, m_header.magic, sizeof(_magic)) != 0)))
+        {
+            close(m_fd);
+            throw std::runtime_error("ReconCheckpoint : '" + fname +
+                                     "' exists and is not a checkpoint file");
+        }
+    }
+
+    ~ReconCheckpoint()
+    {
+        wait();
+        close(m_fd);
+        if(m_saved + m_superseded > 0)
+        {
+            printf("[%lu]> %s : %li checkpoints written (%li superseded), %.4f "
+                   "seconds in the iterations, %.4f seconds in background writes\n",
+                   GetThisThreadID(), "checkpoint", scast<long>(m_saved.load()),
+                   scast<long>(m_superseded.load()), m_snapshot_time,
+                   m_write_time);
+        }
+    }
+
+    ReconCheckpoint(const ReconCheckpoint&) = delete;
+    ReconCheckpoint& operator=(const ReconCheckpoint&) = delete;
+
+public:
+    int interval() const { return m_interval; }
+
+    // number of slabs of the checkpoint in the file (0 if there is nothing to resume)
+    int restored_slabs() const { return m_restored_slabs; }
+
+    // completed iterations of a slab when it was restored
+    int restored_iteration(int slab) const
+    {
+        return (slab < scast<int>(m_restored.size())) ? m_restored[slab] : 0;
+    }
+
+    //----------------------------------------------------------------------------------//
+    //  read the recon of every slab from the newest valid slot if the file holds a
+    //  checkpoint of the same problem
+    //
+    bool restore(float* recon)
+    {
+        Header _header;
+        if(pread(m_fd, &_header, sizeof(Header), 0) != sizeof(Header))
+            return false;
+        m_header.nslabs = _header.nslabs;
+        if(memcmp(&_header, &m_header, sizeof(Header)) != 0 || _header.nslabs < 1)
+        {
+            m_header.nslabs = 0;
+            return false;
+        }
+
+        int nslabs = _header.nslabs;
+        m_restored.assign(nslabs, 0);
+        for(int i = 0; i < nslabs; ++i)
+        {
+            int32_t _iter[2] = { 0, 0 };
+            for(int s = 0; s < 2; ++s)
+                read_at(&_iter[s], sizeof(int32_t), iteration_offset(s, i));
+            int _slot     = (_iter[1] > _iter[0]) ? 1 : 0;
+            m_restored[i] = std::max(_iter[_slot], 0);
+            if(m_restored[i] == 0)
+                continue;
+            auto _range = slab_range(i);
+            read_at(recon + _range.first, _range.second * sizeof(float),
+                    recon_offset(_slot, _range.first));
+        }
+        m_restored_slabs = nslabs;
+        return true;
+    }
+
+    //----------------------------------------------------------------------------------//
+    //  the slabs of the reconstruction and the pool that writes the snapshots, a new
+    //  checkpoint file is laid out unless the slabs were restored
+    //
+    void configure(int nslabs, ThreadPool* tp)
+    {
+        wait();
+        m_pool = tp;
+        m_states.clear();
+        for(int i = 0; i < nslabs; ++i)
+            m_states.push_back(std::unique_ptr<SlabState>(new SlabState));
+
+        if(m_restored_slabs == nslabs)
+        {
+            // keep the valid slot of each slab, write the other one next
+            for(int i = 0; i < nslabs; ++i)
+            {
+                int32_t _iter[2] = { 0, 0 };
+                for(int s = 0; s < 2; ++s)
+                    read_at(&_iter[s], sizeof(int32_t), iteration_offset(s, i));
+                m_states[i]->slot = (_iter[1] > _iter[0]) ? 0 : 1;
+            }
+            return;
+        }
+
+        m_header.nslabs = nslabs;
+        uintmax_t _size = recon_offset(2, 0);
+        if(ftruncate(m_fd, 0) != 0 || ftruncate(m_fd, scast<off_t>(_size)) != 0)
+            throw std::runtime_error("ReconCheckpoint : unable to resize '" + m_fname +
+                                     "' : " + strerror(errno));
+        write_at(&m_header, sizeof(Header), 0);
+    }
+
+    //----------------------------------------------------------------------------------//
+    //  snapshot the recon of the slab after "iteration" completed iterations and
+    //  write it in the background, the "last" iteration is saved regardless of the
+    //  interval
+    //
+    void save(int slab, const float* recon, int iteration, bool last = false)
+    {
+        if((iteration % m_interval != 0 && !last) || m_failed)
+            return;
+
+        auto       _start = clock_type::now();
+        auto       _range = slab_range(slab);
+        SlabState* _state = m_states[slab].get();
+        bool       _launch = false;
+        {
+            AutoLock l(m_mutex);
+            int _buf = (_state->writing == 0) ? 1 : 0;
+            if(_state->pending >= 0)
+            {
+                _buf = _state->pending;
+                ++m_superseded;
+            }
+            _state->buffer[_buf].assign(recon + _range.first,
+                                        recon + _range.first + _range.second);
+            _state->iteration[_buf] = iteration;
+            _state->pending         = _buf;
+            if(!_state->in_flight)
+            {
+                _state->in_flight = true;
+                _launch           = true;
+                ++m_in_flight;
+            }
+        }
+        // one write task per slab at a time, it writes the snapshots of the slab
+        // until there is no pending one. The submissions are serialized with their
+        // own lock because the task runs in place when there is no thread-pool
+        if(_launch)
+        {
+            AutoLock l(m_submit_mutex);
+            if(m_pool)
+                m_pool->add_blocking_task(new PackagedTask<void>([=]() { write(slab); }));
+            else
+                write(slab);
+        }
+        add_time(m_snapshot_time, _start);
+    }
+
+    // wait for the writes in flight
+    void wait()
+    {
+        AutoLock l(m_mutex);
+        m_cv.wait(l, [this]() { return m_in_flight == 0; });
+    }
+
+private:
+    void write(int slab)
+    {
+        SlabState* _state = m_states[slab].get();
+        auto       _range = slab_range(slab);
+        while(true)
+        {
+            int _buf  = -1;
+            int _slot = 0;
+            {
+                AutoLock l(m_mutex);
+                if(_state->pending < 0 || m_failed)
+                {
+                    _state->in_flight = false;
+                    _state->writing   = -1;
+                    _state->pending   = -1;
+                    --m_in_flight;
+                    m_cv.notify_all();
+                    return;
+                }
+                _buf            = _state->pending;
+                _slot           = _state->slot;
+                _state->writing = _buf;
+                _state->pending = -1;
+            }
+
+            auto    _start = clock_type::now();
+            int32_t _iter  = _state->iteration[_buf];
+            int32_t _zero  = 0;
+            try
+            {
+                // invalidate the slot, write and sync the recon, then the iteration
+                write_at(&_zero, sizeof(int32_t), iteration_offset(_slot, slab));
+                write_at(_state->buffer[_buf].data(), _range.second * sizeof(float),
+                         recon_offset(_slot, _range.first));
+                fdatasync(m_fd);
+                write_at(&_iter, sizeof(int32_t), iteration_offset(_slot, slab));
+                fdatasync(m_fd);
+                ++m_saved;
+            }
+            catch(const std::exception& e)
+            {
+                // the reconstruction continues without checkpoints
+                AutoLock l(TypeMutex<decltype(std::cout)>());
+                std::cerr << "[" << GetThisThreadID() << "] checkpoint : " << e.what()
+                          << std::endl;
+                m_failed = true;
+            }
+
+            add_time(m_write_time, _start);
+            AutoLock l(m_mutex);
+            _state->slot = (_slot + 1) % 2;
+        }
+    }
+
+    // [offset, size) of the recon of a slab (in pixels), same partition as CpuSlab
+    std::pair<uintmax_t, uintmax_t> slab_range(int slab) const
+    {
+        int       nslabs = m_header.nslabs;
+        int       dy     = m_header.dy;
+        uintmax_t npix   = scast<uintmax_t>(m_header.nx * m_header.ny);
+        int       begin  = 0;
+        for(int i = 0; i < slab; ++i)
+            begin += dy / nslabs + ((i < dy % nslabs) ? 1 : 0);
+        int _dy = dy / nslabs + ((slab < dy % nslabs) ? 1 : 0);
+        return std::make_pair(begin * npix, _dy * npix);
+    }
+
+    uintmax_t slot_size() const
+    {
+        return sizeof(int32_t) * scast<uintmax_t>(m_header.nslabs) +
+               sizeof(float) * scast<uintmax_t>(m_header.dy) * m_header.nx * m_header.ny;
+    }
+
+    uintmax_t iteration_offset(int slot, int slab) const
+    {
+        return sizeof(Header) + slot * slot_size() + slab * sizeof(int32_t);
+    }
+
+    uintmax_t recon_offset(int slot, uintmax_t pixel) const
+    {
+        return sizeof(Header) + slot * slot_size() +
+               sizeof(int32_t) * scast<uintmax_t>(m_header.nslabs) +
+               pixel * sizeof(float);
+    }
+
+    void read_at(void* buf, uintmax_t n, uintmax_t offset) const
+    {
+        if(pread(m_fd, buf, n, scast<off_t>(offset)) != scast<ssize_t>(n))
+            memset(buf, 0, n);
+    }
+
+    void write_at(const void* buf, uintmax_t n, uintmax_t offset) const
+    {
+        const char* _buf = static_cast<const char*>(buf);
+        while(n > 0)
+        {
+            ssize_t _n = pwrite(m_fd, _buf, n, scast<off_t>(offset));
+            if(_n < 0 && errno == EINTR)
+                continue;
+            if(_n <= 0)
+                throw std::runtime_error("ReconCheckpoint : unable to write '" +
+                                         m_fname + "' : " + strerror(errno));
+            _buf += _n;
+            offset += _n;
+            n -= scast<uintmax_t>(_n);
+        }
+    }
+
+    void add_time(double& _total, const clock_type::time_point& _start)
+    {
+        std::chrono::duration<double> _elapsed = clock_type::now() - _start;
+        AutoLock                      l(m_time_mutex);
+        _total += _elapsed.count();
+    }
+
+private:
+    std::string                             m_fname;
+    int                                     m_fd             = -1;
+    int                                     m_interval       = 1;
+    int                                     m_restored_slabs = 0;
+    Header                                  m_header;
+    iarray_t                                m_restored;
+    std::vector<std::unique_ptr<SlabState>> m_states;
+    int                                     m_in_flight = 0;
+    ThreadPool*                             m_pool      = nullptr;
+    Mutex                                   m_mutex;
+    Mutex                                   m_submit_mutex;
+    Mutex                                   m_time_mutex;
+    Condition                               m_cv;
+    std::atomic<bool>                       m_failed{ false };
+    std::atomic<intmax_t>                   m_saved{ 0 };
+    std::atomic<intmax_t>                   m_superseded{ 0 };
+    double                                  m_snapshot_time = 0.0;
+    double                                  m_write_time    = 0.0;
+};
+
+#else
+
+//--------------------------------------------------------------------------------------//
+//  checkpoints are not supported on Windows
+//
+class ReconCheckpoint
+{
+public:
+    ReconCheckpoint(const std::string& fname, int, int, int, int, int)
+    {
+        printf("[%lu]> %s : checkpoints are not supported, '%s' is not written\n",
+               GetThisThreadID(), "checkpoint", fname.c_str());
+    }
+
+    int  interval() const { return 1; }
+    int  restored_slabs() const { return 0; }
+    int  restored_iteration(int) const { return 0; }
+    bool restore(float*) { return false; }
+    void configure(int, ThreadPool*) {}
+    void save(int, const float*, int, bool = false) {}
+    void wait() {}
+};
+
+#endif
+
+//======================================================================================//
@@ -26,6 +26,7 @@
 
 #include "constants.hh"
 #include "macros.hh"
+#include "scheduler.hh"
 #include "typedefs.hh"
 
 //======================================================================================//
@@ -83,6 +84,32 @@ init_nvtx()
 //
 //======================================================================================//
 
+//  with PTL_SHARED_POOL (default) all the calling threads share one run manager (and
+//  thread-pool) and concurrent reconstructions are jobs on that pool (scheduler.hh),
+//  otherwise each calling thread has its own
+//
+inline bool
+use_shared_pool()
+{
+    static bool _shared = GetEnv<bool>("PTL_SHARED_POOL", true);
+    return _shared;
+}
+
+//--------------------------------------------------------------------------------------//
+//  with PTL_DETERMINISTIC the results do not depend on the number of threads or the
+//  order in which the tasks finish: the partial updates of the projection tasks are
+//  added in a fixed tree over the angles (see CpuSlab::accumulate) and the blocks of
+//  execute_blocks only depend on the size of the loop
+//
+inline bool
+use_deterministic()
+{
+    static bool _deterministic = GetEnv<bool>("PTL_DETERMINISTIC", false);
+    return _deterministic;
+}
+
+//--------------------------------------------------------------------------------------//
+
 inline TaskRunManager*
 cpu_run_manager()
 {
@@ -90,6 +117,12 @@ cpu_run_manager()
     // use unique pointer so manager gets deleted when thread gets deleted
     typedef std::unique_ptr<TaskRunManager> pointer;
     // first argument ensures we do not use TBB backend to PTL
+    if(use_shared_pool())
+    {
+        // only created when the pool is shared
+        static pointer _shared = pointer(new TaskRunManager(false));
+        return _shared.get();
+    }
 #if defined(CXX14)
     static thread_local pointer _instance =
         std::make_unique<TaskRunManager>(new TaskRunManager(false));
@@ -141,9 +174,9 @@ init_run_manager(TaskRunManager*& run_man, uintmax_t nthreads)
 
     ThreadPool* tp = run_man->GetThreadPool();
     // initialize the thread-local data information
-    ThreadData*& thread_data = ThreadData::GetInstance();
+    auto& thread_data = ThreadData::GetInstance();
     if(!thread_data)
-        thread_data = new ThreadData(tp);
+        thread_data.reset(new ThreadData(tp));
     // tell thread that initialized thread-pool to process tasks
     // (typically master thread will only wait for other threads)
     thread_data->is_master = true;
@@ -417,11 +450,60 @@ run_algorithm(_Func&& cpu_func, _Func&& cuda_func, _Args&&... args)
     }
 }
 
+//======================================================================================//
+//
+//  The cxx_osem and cxx_ossirt entry points (and cxx_mlem/cxx_sirt, which are one
+//  subset): "func" runs the reconstruction and returns the number of iterations.
+//  The environment is reported when the last of the concurrent calls returns.
+//
+//======================================================================================//
+
+template <typename _Func>
+int
+run_entry_point(const char* func_name, int dy, int dt, int dx, int ngridx, int ngridy,
+                int num_iter, int num_subsets, _Func&& func)
+{
+    static std::atomic<int> active;
+    int                     count = active++;
+
+    START_TIMER(cxx_timer);
+    TIMEMORY_AUTO_TIMER("");
+
+    printf("[%lu]> %s : nitr = %i, nsub = %i, dy = %i, dt = %i, dx = %i, nx = %i, ny = "
+           "%i\n",
+           GetThisThreadID(), func_name, num_iter, num_subsets, dy, dt, dx, ngridx,
+           ngridy);
+
+    int nitr = 0;
+    {
+        TIMEMORY_AUTO_TIMER("");
+        nitr = func();
+    }
+
+    auto tcount = GetEnv("PTL_PYTHON_THREADS", HW_CONCURRENCY);
+    auto remain = --active;
+    REPORT_TIMER(cxx_timer, func_name, count, tcount);
+    if(remain == 0)
+    {
+        std::stringstream ss;
+        PrintEnv(ss);
+        printf("[%lu] Reporting environment...\n\n%s\n", GetThisThreadID(),
+               ss.str().c_str());
+    }
+    else
+    {
+        printf("[%lu] Threads remaining: %i...\n", GetThisThreadID(), remain);
+    }
+
+    return nitr;
+}
+
 //======================================================================================//
 
 template <typename Executor, typename DataArray, typename Func, typename... Args>
 void
-execute(Executor* man, int dt, DataArray& data, Func&& func, Args&&... args)
+execute(Executor* man, const iarray_t& angles, DataArray& data, Func&& func,
+        Args&&... args)
 {
     // does nothing except make sure there is no warning
     ConsumeParameters(man);
@@ -429,7 +511,7 @@ execute(Executor* man, int dt, DataArray& data, Func&& func, Args&&... args)
     // Loop over slices and projection angles
     auto serial_exec = [&]() {
         // Loop over slices and projection angles
-        for(int p = 0; p < dt; ++p)
+        for(auto p : angles)
         {
             auto _func = std::bind(std::forward<Func>(func), std::ref(data),
                                    std::forward<int>(p), std::forward<Args>(args)...);
@@ -441,7 +523,7 @@ execute(Executor* man, int dt, DataArray& data, Func&& func, Args&&... args)
         if(!man)
             return false;
         TaskGroup<void> tg(man->thread_pool());
-        for(int p = 0; p < dt; ++p)
+        for(auto p : angles)
         {
             auto _func = std::bind(std::forward<Func>(func), std::ref(data),
                                    std::forward<int>(p), std::forward<Args>(args)...);
@@ -470,3 +552,165 @@ execute(Executor* man, int dt, DataArray& data, Func&& func, Args&&... args)
 }
 
 //======================================================================================//
+//
+//  Execute "func" for the "angles" as one of the concurrent jobs on a thread-pool:
+//  instead of a task per angle, the job claims its share of the workers and that
+//  many tasks pull the angles from a counter (see ReconJob)
+//
+//======================================================================================//
+
+template <typename Executor, typename DataArray, typename Func, typename... Args>
+void
+execute(Executor* man, ReconJob* job, const iarray_t& angles, DataArray& data,
+        Func&& func, Args&&... args)
+{
+    if(!man || !job)
+    {
+        execute<Executor, DataArray>(man, angles, data, std::forward<Func>(func),
+                                     std::forward<Args>(args)...);
+        return;
+    }
+
+    intmax_t nworkers = scast<intmax_t>(man->thread_pool()->size());
+    intmax_t ntasks   = job->acquire(scast<intmax_t>(angles.size()), nworkers);
+
+    std::atomic<uintmax_t> counter(0);
+    auto                   _pull = [&]() {
+        for(uintmax_t i = counter++; i < angles.size(); i = counter++)
+            func(data, angles[i], args...);
+    };
+
+    try
+    {
+        TaskGroup<void> tg(man->thread_pool());
+        for(intmax_t i = 0; i < ntasks; ++i)
+            tg.run(_pull);
+        tg.join();
+        job->release(ntasks);
+    }
+    catch(const std::exception& e)
+    {
+        job->release(ntasks);
+        std::stringstream ss;
+        ss << "\n\nError executing :: " << e.what() << "\n\n";
+        {
+            AutoLock l(TypeMutex<decltype(std::cout)>());
+            std::cerr << e.what() << std::endl;
+        }
+        throw std::runtime_error(ss.str().c_str());
+    }
+}
+
+//======================================================================================//
+
+template <typename Executor, typename DataArray, typename Func, typename... Args>
+void
+execute(Executor* man, int dt, DataArray& data, Func&& func, Args&&... args)
+{
+    iarray_t angles(dt, 0);
+    std::iota(angles.begin(), angles.end(), 0);
+    execute<Executor, DataArray>(man, angles, data, std::forward<Func>(func),
+                                 std::forward<Args>(args)...);
+}
+
+//======================================================================================//
+//
+//  Execute "func(begin, end)" over contiguous blocks of [0, size) on the thread-pool
+//  and combine the value returned by each block with operator+=. Blocks are at
+//  least PTL_MIN_BLOCK_SIZE elements so small images are not split needlessly.
+//  In deterministic mode there are size / PTL_MIN_BLOCK_SIZE blocks, at most
+//  PTL_DETERMINISTIC_BLOCKS (default: 64), regardless of the size of the pool so the
+//  values are combined in the same order on every run.
+//
+//======================================================================================//
+
+template <typename _Tp, typename Executor, typename Func>
+_Tp
+execute_blocks(Executor* man, uintmax_t size, Func&& func)
+{
+    uintmax_t min_block = GetEnv<uintmax_t>("PTL_MIN_BLOCK_SIZE", 4096);
+    uintmax_t nblocks   = (man) ? 4 * scast<uintmax_t>(man->thread_pool()->size()) : 1;
+    min_block           = std::max<uintmax_t>(min_block, 1);
+    if(use_deterministic())
+        nblocks = GetEnv<uintmax_t>("PTL_DETERMINISTIC_BLOCKS", 64);
+    nblocks = std::max<uintmax_t>(std::min(nblocks, size / min_block), 1);
+
+    if(nblocks == 1)
+        return func(uintmax_t(0), size);
+
+    auto join  = [](_Tp& lhs, _Tp rhs) { return lhs += rhs; };
+    auto block = (size + nblocks - 1) / nblocks;
+
+    // without a thread-pool the blocks are combined in the same order
+    if(!man)
+    {
+        _Tp _ret{};
+        for(uintmax_t _beg = 0; _beg < size; _beg += block)
+            join(_ret, func(_beg, std::min(_beg + block, size)));
+        return _ret;
+    }
+
+    try
+    {
+        TaskGroup<_Tp> tg(join, man->thread_pool());
+        for(uintmax_t _beg = 0; _beg < size; _beg += block)
+        {
+            uintmax_t _end = std::min(_beg + block, size);
+            tg.run([=, &func]() { return func(_beg, _end); });
+        }
+        return tg.join(_Tp{});
+    }
+    catch(const std::exception& e)
+    {
+        std::stringstream ss;
+        ss << "\n\nError executing :: " << e.what() << "\n\n";
+        {
+            AutoLock l(TypeMutex<decltype(std::cout)>());
+            std::cerr << e.what() << std::endl;
+        }
+        throw std::runtime_error(ss.str().c_str());
+    }
+}
+
+//======================================================================================//
+//
+//  Ordered subsets: the projection angles are partitioned into "num_subsets"
+//  interleaved subsets (subset k holds angles k, k + num_subsets, ...) and the
+//  subsets are visited in bit-reversed order so that consecutive subsets are
+//  as far apart in angle as possible. One subset reproduces the full
+//  (non-ordered-subset) update.
+//
+//======================================================================================//
+
+inline std::vector<iarray_t>
+compute_ordered_subsets(int dt, int num_subsets)
+{
+    num_subsets = std::max(std::min(num_subsets, dt), 1);
+
+    // bit-reverse the subset indices over the next power of two
+    int nbits = 0;
+    while((1 << nbits) < num_subsets)
+        ++nbits;
+
+    auto reverse = [nbits](int val) {
+        int ret = 0;
+        for(int i = 0; i < nbits; ++i)
+            ret |= ((val >> i) & 1) << (nbits - 1 - i);
+        return ret;
+    };
+
+    std::vector<iarray_t> subsets;
+    for(int i = 0; i < (1 << nbits); ++i)
+    {
+        int k = reverse(i);
+        if(k >= num_subsets)
+            continue;
+        iarray_t angles;
+        for(int p = k; p < dt; p += num_subsets)
+            angles.push_back(p);
+        subsets.push_back(angles);
+    }
+    return subsets;
+}
+
+//======================================================================================//
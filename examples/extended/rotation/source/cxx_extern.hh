@@ -34,10 +34,28 @@
 
 // generic decision of whether to use CPU or GPU version
 //     NOTE: if compiled with GPU support but no devices, will call CPU version
+//     NOTE: returns the number of iterations run, this is less than "num_iter" when
+//           the relative change of the recon drops below PTL_CONVERGENCE_TOL
 DLL int
 cxx_mlem(const float* data, int dy, int dt, int dx, const float* center,
          const float* theta, float* recon, int ngridx, int ngridy, int num_iter);
 
+// ordered-subsets MLEM (OS-EM): the reconstruction is updated after each of the
+// "num_subsets" subsets of projection angles instead of once per iteration
+DLL int
+cxx_osem(const float* data, int dy, int dt, int dx, const float* center,
+         const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+         int num_subsets);
+
+// OS-EM that checkpoints to the file "checkpoint" every PTL_CHECKPOINT_INTERVAL
+// iterations and resumes from it when it holds a checkpoint of the same problem
+//     NOTE: returns the total number of iterations completed (including the resumed
+//           iterations) or -1 if the checkpoint file cannot be used
+DLL int
+cxx_mlem_resume(const float* data, int dy, int dt, int dx, const float* center,
+                const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+                int num_subsets, const char* checkpoint);
+
 //======================================================================================//
 //
 //  SIRT
@@ -46,8 +64,70 @@ cxx_mlem(const float* data, int dy, int dt, int dx, const float* center,
 
 // generic decision of whether to use CPU or GPU version
 //     NOTE: if compiled with GPU support but no devices, will call CPU version
+//     NOTE: returns the number of iterations run (see cxx_mlem)
 DLL int
 cxx_sirt(const float* data, int dy, int dt, int dx, const float* center,
          const float* theta, float* recon, int ngridx, int ngridy, int num_iter);
 
+// ordered-subsets SIRT (OS-SIRT): the reconstruction is updated after each of the
+// "num_subsets" subsets of projection angles instead of once per iteration
+DLL int
+cxx_ossirt(const float* data, int dy, int dt, int dx, const float* center,
+           const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+           int num_subsets);
+
+// checkpointed OS-SIRT (see cxx_mlem_resume)
+DLL int
+cxx_sirt_resume(const float* data, int dy, int dt, int dx, const float* center,
+                const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+                int num_subsets, const char* checkpoint);
+
+//======================================================================================//
+//
+//  Streaming reconstructions
+//
+//======================================================================================//
+
+// reconstruct the raw sinogram file "sinogram" (see stream.hh for the layout) slab by
+// slab into the raw volume file "output" without holding either fully in memory
+DLL int
+cxx_mlem_stream(const char* sinogram, const char* output, const float* theta,
+                int ngridx, int ngridy, int num_iter, int num_subsets);
+
+DLL int
+cxx_sirt_stream(const char* sinogram, const char* output, const float* theta,
+                int ngridx, int ngridy, int num_iter, int num_subsets);
+
+//======================================================================================//
+//
+//  Reconstruction service
+//
+//======================================================================================//
+
+// progress of a job: number of slabs done, number of slabs and seconds since the
+// service received the job
+typedef void (*cxx_service_progress_t)(int slab, int nslabs, double elapsed);
+
+// run the reconstruction service on the Unix domain socket "socket_path". The
+// thread-pool, the sum_dist cache and the buffers stay warm between the jobs.
+// cxx_service_run blocks until cxx_service_stop is called, cxx_service_start runs
+// the service on a background thread (e.g. in the same process as the client)
+DLL int
+cxx_service_run(const char* socket_path);
+
+DLL int
+cxx_service_start(const char* socket_path);
+
+DLL int
+cxx_service_stop();
+
+// submit a streaming reconstruction (algorithm: 0 = MLEM, 1 = SIRT) of the raw
+// sinogram file "sinogram" into the raw volume file "output" to the service and
+// wait for it to finish. "progress" may be null
+DLL int
+cxx_service_submit(const char* socket_path, int algorithm, const char* sinogram,
+                   const char* output, const float* theta, int nangles, int ngridx,
+                   int ngridy, int num_iter, int num_subsets,
+                   cxx_service_progress_t progress);
+
 //======================================================================================//
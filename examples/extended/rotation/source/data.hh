@@ -28,6 +28,7 @@
 #include "constants.hh"
 #include "macros.hh"
 #include "rotate_utils.hh"
+#include "storage.hh"
 #include "typedefs.hh"
 
 //======================================================================================//
@@ -123,6 +124,217 @@ protected:
     Mutex*       m_sum_mutex;
 };
 
+//======================================================================================//
+//
+//  Per-iteration convergence metrics. The change and norm of the recon are reduced
+//  in the (parallel) update pass and the residual of the data-fidelity term is
+//  accumulated by the projection tasks, which already compute the forward projection.
+//
+//======================================================================================//
+
+struct IterationMetrics
+{
+    intmax_t nfail    = 0;    // number of non-finite update values
+    double   change   = 0.0;  // sum of the squared change of the recon
+    double   norm     = 0.0;  // sum of the squared recon
+    double   residual = 0.0;  // sum of the squared (data - forward projection)
+    double   data     = 0.0;  // sum of the squared data
+
+    IterationMetrics& operator+=(const IterationMetrics& rhs)
+    {
+        nfail += rhs.nfail;
+        change += rhs.change;
+        norm += rhs.norm;
+        residual += rhs.residual;
+        data += rhs.data;
+        return *this;
+    }
+
+    // || x_{k+1} - x_{k} || / || x_{k+1} ||
+    double relative_change() const { return (norm > 0.0) ? sqrt(change / norm) : 0.0; }
+
+    // || b - A x_{k} || / || b ||
+    double relative_residual() const
+    {
+        return (data > 0.0) ? sqrt(residual / data) : 0.0;
+    }
+};
+
+//--------------------------------------------------------------------------------------//
+//  tolerance on the relative change of the recon for ending the iterations early,
+//  a value <= 0 always runs the requested number of iterations
+//
+inline double
+GetConvergenceTolerance()
+{
+    static double tol = GetEnv<double>("PTL_CONVERGENCE_TOL", 0.0);
+    return tol;
+}
+
+//======================================================================================//
+//
+//  A contiguous range of slices [begin, begin + dy). The slices of a reconstruction
+//  are independent so each slab advances through the iterations on its own and only
+//  has to wait on its own projection tasks. The thread-local scratch (rot, tmp)
+//  stays in CpuData and is shared by all the slabs. The sinogram may be stored in a
+//  16-bit type (see storage.hh), it is converted to float when it is read.
+//
+//======================================================================================//
+
+template <typename _Sp = float>
+class CpuSlab
+{
+public:
+    typedef _Sp                      storage_type;
+    typedef std::shared_ptr<CpuSlab> slab_ptr_t;
+    typedef std::vector<slab_ptr_t>  slab_array_t;
+
+public:
+    CpuSlab(int index, int begin, int dy, int dt, int dx, int nx, int ny, const _Sp* data,
+            float* recon, float* update)
+    : m_index(index)
+    , m_begin(begin)
+    , m_dy(dy)
+    , m_nx(nx)
+    , m_ny(ny)
+    , m_update(update + begin * nx * ny)
+    , m_recon(recon + begin * nx * ny)
+    , m_data(data + begin * dt * dx)
+    {
+    }
+
+public:
+    int       index() const { return m_index; }
+    int       begin() const { return m_begin; }
+    int       dy() const { return m_dy; }
+    uintmax_t size() const { return scast<uintmax_t>(m_dy * m_nx * m_ny); }
+    uintmax_t offset() const { return scast<uintmax_t>(m_begin * m_nx * m_ny); }
+
+    float*       update() const { return m_update; }
+    float*       recon() { return m_recon; }
+    const float* recon() const { return m_recon; }
+    const _Sp*   data() const { return m_data; }
+
+    Mutex* upd_mutex() { return &m_upd_mutex; }
+
+    // accumulated by the projection tasks while holding upd_mutex()
+    IterationMetrics& metrics() { return m_metrics; }
+
+    // in deterministic mode the partial updates of the projection tasks are combined
+    // in a fixed pairwise tree over the positions in "angles" instead of in the order
+    // the tasks finish in: the two halves of a node are added as soon as both are
+    // complete and the root is added to update(). Only the nodes waiting for their
+    // other half are held, i.e. at most a few per level for each task in flight
+    void set_order(const iarray_t* angles)
+    {
+        AutoLock l(m_upd_mutex);
+        m_order = angles;
+        m_pending.clear();
+        m_position.clear();
+        for(uintmax_t i = 0; angles && i < angles->size(); ++i)
+            m_position[angles->at(i)] = i;
+    }
+
+    // add the partial update (and metrics) of projection angle "p" to update()
+    void accumulate(int p, PooledBuffer&& partial, double residual, double data)
+    {
+        AutoLock l(m_upd_mutex);
+        if(!m_order)
+        {
+            add(partial.data(), residual, data);
+            return;
+        }
+
+        // walk up from the leaf while the other half of the node is complete (or
+        // beyond the last angle)
+        uintmax_t n     = m_order->size();
+        uintmax_t level = 0;
+        uintmax_t index = m_position.at(p);
+        pending_t node(std::move(partial), residual, data);
+        while((uintmax_t(1) << level) < n)
+        {
+            uintmax_t sibling = index ^ 1;
+            if((sibling << level) < n)
+            {
+                auto itr = m_pending.find(node_t(level, sibling));
+                if(itr == m_pending.end())
+                {
+                    m_pending.emplace(node_t(level, index), std::move(node));
+                    return;
+                }
+                // the addition is commutative so the order of the halves is irrelevant
+                float* _sibling = itr->second.buffer.data();
+                for(uintmax_t i = 0; i < size(); ++i)
+                    node.buffer[i] += _sibling[i];
+                node.residual += itr->second.residual;
+                node.data += itr->second.data;
+                m_pending.erase(itr);
+            }
+            ++level;
+            index >>= 1;
+        }
+        add(node.buffer.data(), node.residual, node.data);
+    }
+
+public:
+    // split "dy" slices into (at most) "nslabs" slabs of nearly equal size
+    static slab_array_t partition(int nslabs, int dy, int dt, int dx, int nx, int ny,
+                                  const _Sp* data, float* recon, float* update)
+    {
+        nslabs = std::max(std::min(nslabs, dy), 1);
+        slab_array_t slabs;
+        for(int i = 0, begin = 0; i < nslabs; ++i)
+        {
+            int _dy = dy / nslabs + ((i < dy % nslabs) ? 1 : 0);
+            slabs.push_back(slab_ptr_t(
+                new CpuSlab(i, begin, _dy, dt, dx, nx, ny, data, recon, update)));
+            begin += _dy;
+        }
+        return slabs;
+    }
+
+protected:
+    // (level, index) of a node of the tree, the leaves are level 0
+    typedef std::pair<uintmax_t, uintmax_t> node_t;
+
+    struct pending_t
+    {
+        pending_t(PooledBuffer&& _buffer, double _residual, double _data)
+        : buffer(std::move(_buffer))
+        , residual(_residual)
+        , data(_data)
+        {
+        }
+
+        PooledBuffer buffer;
+        double       residual;
+        double       data;
+    };
+
+    void add(float* partial, double residual, double data)
+    {
+        for(uintmax_t i = 0; i < size(); ++i)
+            m_update[i] += partial[i];
+        m_metrics.residual += residual;
+        m_metrics.data += data;
+    }
+
+protected:
+    int                         m_index;
+    int                         m_begin;
+    int                         m_dy;
+    int                         m_nx;
+    int                         m_ny;
+    float*                      m_update;
+    float*                      m_recon;
+    const _Sp*                  m_data;
+    Mutex                       m_upd_mutex;
+    IterationMetrics            m_metrics;
+    const iarray_t*             m_order = nullptr;
+    std::map<int, uintmax_t>    m_position;
+    std::map<node_t, pending_t> m_pending;
+};
+
 //======================================================================================//
 
 #if defined(__NVCC__) && defined(PTL_USE_CUDA)
@@ -121,6 +121,13 @@
 #include <cstring>
 #include <ctime>
 
+#if !defined(_WIN32)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
 //======================================================================================//
 //  C++ headers
 
@@ -136,6 +143,7 @@
 #include <iomanip>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <memory>
 #include <new>
 #include <numeric>
@@ -198,7 +206,7 @@ GetThisThreadID()
 //======================================================================================//
 // get the number of hardware threads
 #if !defined(HW_CONCURRENCY)
-#    define HW_CONCURRENCY std::thread::hardware_concurrency()
+#    define HW_CONCURRENCY Threading::GetNumberOfAvailableCores()
 #endif
 
 //======================================================================================//
@@ -0,0 +1,234 @@
+// MIT License
+//
+// Copyright (c) 2019 Jonathan R. Madsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+
+#pragma once
+
+#include "checkpoint.hh"
+#include "macros.hh"
+#include "typedefs.hh"
+
+//======================================================================================//
+//
+//  Multi-resolution (coarse-to-fine) initialization. The detector and the grid are
+//  downsampled by a factor of 2 per level and the coarsest level is reconstructed
+//  first. The result of each level is upsampled as the initial guess of the next
+//  finer level, the full resolution reconstruction then starts from the result of
+//  the finest coarse level instead of the caller's (usually constant) recon. An
+//  iteration of a level costs ~1/4 of the level above it and the coarse levels
+//  remove most of the low-frequency error, so far fewer full resolution iterations
+//  are needed (see PTL_CONVERGENCE_TOL).
+//
+//      PTL_MULTIGRID_LEVELS        number of coarse levels (0 = disabled)
+//      PTL_MULTIGRID_ITERATIONS    iterations per coarse level (default: num_iter)
+//      PTL_MULTIGRID_MIN_SIZE      smallest grid/detector size of a coarse level
+//
+//======================================================================================//
+
+struct MultigridLevel
+{
+    int factor;  // downsampling factor w.r.t. full resolution
+    int nx;      // grid size
+    int ny;      // grid size
+    int dx;      // detector size
+    int ox;      // offset of the grid in full resolution pixels
+    int oy;      // offset of the grid in full resolution pixels
+    int od;      // offset of the detector in full resolution pixels
+
+    MultigridLevel(int _factor, int ngridx, int ngridy, int ndx)
+    : factor(_factor)
+    , nx(ngridx / _factor)
+    , ny(ngridy / _factor)
+    , dx(ndx / _factor)
+    , ox((ngridx - nx * _factor) / 2)
+    , oy((ngridy - ny * _factor) / 2)
+    , od((ndx - dx * _factor) / 2)
+    {
+    }
+};
+
+//--------------------------------------------------------------------------------------//
+//  average "factor" detector pixels. The forward projection is a sum over the grid
+//  pixels along the ray so a coarse ray crosses "factor" times fewer pixels and the
+//  average is scaled by 1 / factor to keep the image values of the levels comparable
+//
+inline farray_t
+multigrid_downsample_data(const float* data, int dy, int dt, int dx,
+                          const MultigridLevel& lvl)
+{
+    farray_t _data(scast<uintmax_t>(dy * dt * lvl.dx), 0.0f);
+    float    _norm = 1.0f / scast<float>(lvl.factor * lvl.factor);
+    for(int s = 0; s < dy * dt; ++s)
+    {
+        const float* _src = data + s * dx + lvl.od;
+        float*       _dst = _data.data() + s * lvl.dx;
+        for(int d = 0; d < lvl.dx; ++d)
+        {
+            float _sum = 0.0f;
+            for(int j = 0; j < lvl.factor; ++j)
+                _sum += _src[d * lvl.factor + j];
+            _dst[d] = _sum * _norm;
+        }
+    }
+    return _data;
+}
+
+//--------------------------------------------------------------------------------------//
+//  average blocks of factor x factor pixels of a full resolution image
+//
+inline farray_t
+multigrid_downsample_image(const float* image, int dy, int nx, int ny,
+                           const MultigridLevel& lvl)
+{
+    farray_t _image(scast<uintmax_t>(dy * lvl.nx * lvl.ny), 0.0f);
+    float    _norm = 1.0f / scast<float>(lvl.factor * lvl.factor);
+    for(int s = 0; s < dy; ++s)
+    {
+        const float* _src = image + s * nx * ny;
+        float*       _dst = _image.data() + s * lvl.nx * lvl.ny;
+        for(int r = 0; r < lvl.ny; ++r)
+        {
+            for(int c = 0; c < lvl.nx; ++c)
+            {
+                float _sum = 0.0f;
+                for(int j = 0; j < lvl.factor; ++j)
+                    for(int i = 0; i < lvl.factor; ++i)
+                        _sum += _src[(lvl.oy + r * lvl.factor + j) * nx + lvl.ox +
+                                     c * lvl.factor + i];
+                _dst[r * lvl.nx + c] = _sum * _norm;
+            }
+        }
+    }
+    return _image;
+}
+
+//--------------------------------------------------------------------------------------//
+//  bilinear interpolation of the image of level "from" onto the grid of level "to",
+//  the pixel centers of both levels are mapped through full resolution coordinates
+//
+inline void
+multigrid_upsample_image(const float* src, const MultigridLevel& from, float* dst,
+                         const MultigridLevel& to, int dy)
+{
+    auto _coord = [](int i, int to_off, int to_fac, int from_off, int from_fac, int n,
+                     int& i0, int& i1, float& w) {
+        float _x = (to_off + (i + 0.5f) * to_fac - from_off) / from_fac - 0.5f;
+        _x       = std::max(std::min(_x, scast<float>(n - 1)), 0.0f);
+        i0       = scast<int>(_x);
+        i1       = std::min(i0 + 1, n - 1);
+        w        = _x - i0;
+    };
+
+    for(int s = 0; s < dy; ++s)
+    {
+        const float* _src = src + s * from.nx * from.ny;
+        float*       _dst = dst + s * to.nx * to.ny;
+        for(int r = 0; r < to.ny; ++r)
+        {
+            int   r0, r1;
+            float wr;
+            _coord(r, to.oy, to.factor, from.oy, from.factor, from.ny, r0, r1, wr);
+            for(int c = 0; c < to.nx; ++c)
+            {
+                int   c0, c1;
+                float wc;
+                _coord(c, to.ox, to.factor, from.ox, from.factor, from.nx, c0, c1, wc);
+                float _top = (1.0f - wc) * _src[r0 * from.nx + c0] +
+                             wc * _src[r0 * from.nx + c1];
+                float _bot = (1.0f - wc) * _src[r1 * from.nx + c0] +
+                             wc * _src[r1 * from.nx + c1];
+                _dst[r * to.nx + c] = (1.0f - wr) * _top + wr * _bot;
+            }
+        }
+    }
+}
+
+//======================================================================================//
+//
+//  "func" is the (full resolution) reconstruction, it is invoked for every level
+//  with the downsampled sinogram and grid. Returns the number of full resolution
+//  iterations run. Only the full resolution is checkpointed and the coarse levels are
+//  skipped when the recon is restored from the checkpoint.
+//
+template <typename _Func>
+int
+multigrid_reconstruct(_Func&& func, const float* data, int dy, int dt, int dx,
+                      const float* center, const float* theta, float* recon, int ngridx,
+                      int ngridy, int num_iter, int num_subsets,
+                      ReconCheckpoint* checkpoint = nullptr)
+{
+    int nlevels  = GetEnv<int>("PTL_MULTIGRID_LEVELS", 0);
+    int min_size = GetEnv<int>("PTL_MULTIGRID_MIN_SIZE", 32);
+
+    std::vector<MultigridLevel> levels = { MultigridLevel(1, ngridx, ngridy, dx) };
+    for(int l = 1; l <= nlevels && l < 16; ++l)
+    {
+        MultigridLevel _lvl(1 << l, ngridx, ngridy, dx);
+        if(std::min(std::min(_lvl.nx, _lvl.ny), _lvl.dx) < std::max(min_size, 1))
+            break;
+        levels.push_back(_lvl);
+    }
+
+    if(checkpoint && checkpoint->restore(recon))
+        levels.erase(levels.begin() + 1, levels.end());
+
+    if(levels.size() > 1)
+    {
+        int      coarse_iter = GetEnv<int>("PTL_MULTIGRID_ITERATIONS", num_iter);
+        int      ncoarse     = scast<int>(levels.size()) - 1;
+        farray_t _recon      = multigrid_downsample_image(recon, dy, ngridx, ngridy,
+                                                          levels.back());
+
+        for(int l = ncoarse; l > 0; --l)
+        {
+            START_TIMER(t_start);
+            const auto& _lvl  = levels[l];
+            const auto& _next = levels[l - 1];
+            farray_t    _data = multigrid_downsample_data(data, dy, dt, dx, _lvl);
+
+            printf("[%lu]> %s : level %i, factor = %i, dx = %i, nx = %i, ny = %i\n",
+                   GetThisThreadID(), __FUNCTION__, l, _lvl.factor, _lvl.dx, _lvl.nx,
+                   _lvl.ny);
+
+            func(_data.data(), dy, dt, _lvl.dx, center, theta, _recon.data(), _lvl.nx,
+                 _lvl.ny, coarse_iter, num_subsets, nullptr);
+
+            // the initial guess of the next finer level
+            if(l > 1)
+            {
+                farray_t _init(scast<uintmax_t>(dy * _next.nx * _next.ny), 0.0f);
+                multigrid_upsample_image(_recon.data(), _lvl, _init.data(), _next, dy);
+                std::swap(_recon, _init);
+            }
+            else
+                multigrid_upsample_image(_recon.data(), _lvl, recon, _next, dy);
+
+            REPORT_TIMER(t_start, "multigrid level", l, ncoarse);
+        }
+    }
+
+    return func(data, dy, dt, dx, center, theta, recon, ngridx, ngridy, num_iter,
+                num_subsets, checkpoint);
+}
+
+//======================================================================================//
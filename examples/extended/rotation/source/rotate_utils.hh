@@ -138,36 +138,325 @@ cxx_rotate(const _Tp* src, double theta, const intmax_t& nx, const intmax_t& ny,
 
 //--------------------------------------------------------------------------------------//
 
+//  the sensitivity (sum_dist) image only depends on the geometry (dx, nx, ny) and the
+//  projection angles and is the same for every slice so only one slice is computed.
+//  The angles are split into chunks that are rotated on the thread-pool and the
+//  integer partial sums are combined by the TaskGroup join
+//
 inline iarray_t
-cxx_compute_sum_dist(int dy, int dt, int dx, int nx, int ny, const float* theta)
+cxx_compute_sum_dist_slice(TaskManager* man, int dx, int nx, int ny, const float* theta,
+                           const iarray_t& angles)
 {
-    auto compute = [&](const iarray_t& ones, iarray_t& sum_dist) {
-        for(int s = 0; s < dy; ++s)
+    auto compute = [=](const iarray_t& _angles) {
+        iarray_t rot(nx * ny, 0);
+        iarray_t tmp(nx * ny, 1);
+        iarray_t sum_dist(nx * ny, 0);
+        for(auto p : _angles)
         {
+            float theta_p_rad = fmodf(theta[p] + constants::halfpi, constants::twopi);
+            cxx_rotate_ip(rot, tmp.data(), -theta_p_rad, nx, ny, CPU_NN);
             for(int d = 0; d < dx; ++d)
             {
-                int32_t*       _sum_dist = sum_dist.data() + (s * nx * ny) + (d * nx);
-                const int32_t* _ones     = ones.data() + (d * nx);
+                int32_t*       _sum_dist = sum_dist.data() + (d * nx);
+                const int32_t* _ones     = rot.data() + (d * nx);
                 for(int n = 0; n < nx; ++n)
-                {
                     _sum_dist[n] += (_ones[n] > 0) ? 1 : 0;
-                }
             }
         }
+        return sum_dist;
+    };
+
+    uintmax_t nangles = angles.size();
+    uintmax_t nchunks = (man) ? 2 * scast<uintmax_t>(man->thread_pool()->size()) : 1;
+    nchunks           = std::max<uintmax_t>(std::min(nchunks, nangles), 1);
+
+    if(nchunks == 1)
+        return compute(angles);
+
+    auto join = [](iarray_t& lhs, iarray_t rhs) {
+        if(lhs.empty())
+            return rhs;
+        for(uintmax_t i = 0; i < lhs.size(); ++i)
+            lhs[i] += rhs[i];
+        return lhs;
+    };
+
+    TaskGroup<iarray_t> tg(join, man->thread_pool());
+    for(uintmax_t i = 0; i < nchunks; ++i)
+    {
+        iarray_t _angles;
+        for(uintmax_t j = i; j < nangles; j += nchunks)
+            _angles.push_back(angles[j]);
+        tg.run([=]() { return compute(_angles); });
+    }
+    return tg.join(iarray_t{});
+}
+
+//--------------------------------------------------------------------------------------//
+//  process-wide cache of the sum_dist slices keyed on geometry and the projection
+//  angles. When PTL_SUM_DIST_CACHE_DIR is set, the slices are also persisted to
+//  (and loaded from) memory-mapped files in that directory so they survive between
+//  processes. Set PTL_SUM_DIST_CACHE=OFF to disable caching entirely. At most
+//  PTL_SUM_DIST_CACHE_SIZE slices (default 32) are kept in memory, the least recently
+//  used slice is evicted first.
+//
+class SumDistCache
+{
+public:
+    typedef std::shared_ptr<const iarray_t> pointer;
+
+    static SumDistCache& instance()
+    {
+        static SumDistCache _instance;
+        return _instance;
+    }
+
+    pointer get(TaskManager* man, int dx, int nx, int ny, const float* theta,
+                const iarray_t& angles)
+    {
+        static bool _enabled = GetEnv<bool>("PTL_SUM_DIST_CACHE", true);
+        if(!_enabled)
+            return pointer(new iarray_t(
+                cxx_compute_sum_dist_slice(man, dx, nx, ny, theta, angles)));
+
+        key_t _key = make_key(dx, nx, ny, theta, angles);
+        {
+            AutoLock l(TypeMutex<SumDistCache>());
+            auto     itr = m_cache.find(_key);
+            if(itr != m_cache.end())
+            {
+                itr->second.last_use = ++m_clock;
+                return itr->second.sum_dist;
+            }
+        }
+
+        // compute outside of the lock, concurrent misses on the same key are benign
+        pointer _sum_dist = load(_key);
+        if(!_sum_dist)
+        {
+            _sum_dist = pointer(new iarray_t(
+                cxx_compute_sum_dist_slice(man, dx, nx, ny, theta, angles)));
+            store(_key, *_sum_dist);
+        }
+
+        AutoLock l(TypeMutex<SumDistCache>());
+        auto     itr = m_cache.insert(std::make_pair(_key, entry_t{ _sum_dist, 0 }));
+        itr.first->second.last_use = ++m_clock;
+        _sum_dist                  = itr.first->second.sum_dist;
+        evict();
+        return _sum_dist;
+    }
+
+    void clear()
+    {
+        AutoLock l(TypeMutex<SumDistCache>());
+        m_cache.clear();
+    }
+
+private:
+    // the key doubles as the header of the on-disk file
+    struct header_t
+    {
+        char     magic[8];
+        uint64_t hash;
+        int32_t  dx;
+        int32_t  nx;
+        int32_t  ny;
+        int32_t  nangles;
+
+        bool operator<(const header_t& rhs) const
+        {
+            return std::tie(hash, dx, nx, ny, nangles) <
+                   std::tie(rhs.hash, rhs.dx, rhs.nx, rhs.ny, rhs.nangles);
+        }
+    };
+
+    // the hash only names the file, the bit-patterns of the projection angles are
+    // compared so a collision is a miss instead of the wrong slice
+    struct key_t
+    {
+        header_t              header;
+        std::vector<uint32_t> angles;
+
+        bool operator<(const key_t& rhs) const
+        {
+            if(header < rhs.header)
+                return true;
+            if(rhs.header < header)
+                return false;
+            return angles < rhs.angles;
+        }
+    };
+
+    struct entry_t
+    {
+        pointer   sum_dist;
+        uintmax_t last_use;
     };
 
-    iarray_t rot(nx * ny, 0);
-    iarray_t tmp(nx * ny, 1);
-    iarray_t sum_dist(dy * nx * ny, 0);
+    static constexpr const char* magic() { return "PTLSDST2"; }
+
+    static key_t make_key(int dx, int nx, int ny, const float* theta,
+                          const iarray_t& angles)
+    {
+        key_t _key;
+        _key.angles.reserve(angles.size());
+        // FNV-1a hash of the bit-patterns of the projection angles
+        uint64_t _hash = 14695981039346656037ULL;
+        for(auto p : angles)
+        {
+            uint32_t _bits = 0;
+            memcpy(&_bits, theta + p, sizeof(_bits));
+            _key.angles.push_back(_bits);
+            for(int i = 0; i < 4; ++i)
+            {
+                _hash ^= (_bits >> (8 * i)) & 0xff;
+                _hash *= 1099511628211ULL;
+            }
+        }
+        header_t& _hdr = _key.header;
+        memcpy(_hdr.magic, magic(), sizeof(_hdr.magic));
+        _hdr.hash    = _hash;
+        _hdr.dx      = dx;
+        _hdr.nx      = nx;
+        _hdr.ny      = ny;
+        _hdr.nangles = scast<int32_t>(angles.size());
+        return _key;
+    }
+
+    // drop the least recently used slices, called with the lock held
+    void evict()
+    {
+        static uintmax_t _max = GetEnv<uintmax_t>("PTL_SUM_DIST_CACHE_SIZE", 32);
+        while(m_cache.size() > std::max<uintmax_t>(_max, 1))
+        {
+            auto _oldest = m_cache.begin();
+            for(auto itr = m_cache.begin(); itr != m_cache.end(); ++itr)
+                if(itr->second.last_use < _oldest->second.last_use)
+                    _oldest = itr;
+            m_cache.erase(_oldest);
+        }
+    }
+
+    static std::string filename(const header_t& _key)
+    {
+        static std::string _dir = GetEnv<std::string>("PTL_SUM_DIST_CACHE_DIR", "");
+        if(_dir.empty())
+            return _dir;
+        std::stringstream ss;
+        ss << _dir << "/sum_dist_" << _key.nx << "x" << _key.ny << "_" << _key.dx << "_"
+           << _key.nangles << "_" << std::hex << _key.hash << ".bin";
+        return ss.str();
+    }
+
+    // the header, the bit-patterns of the angles and the slice
+    static uintmax_t file_size(const header_t& _key)
+    {
+        return sizeof(header_t) + scast<uintmax_t>(_key.nangles) * sizeof(uint32_t) +
+               scast<uintmax_t>(_key.nx * _key.ny) * sizeof(int32_t);
+    }
+
+#if !defined(_WIN32)
+    static pointer load(const key_t& _key)
+    {
+        std::string _fname = filename(_key.header);
+        if(_fname.empty())
+            return pointer();
+
+        int fd = open(_fname.c_str(), O_RDONLY);
+        if(fd < 0)
+            return pointer();
+
+        pointer     _ret;
+        struct stat _stat;
+        uintmax_t   _size = file_size(_key.header);
+        if(fstat(fd, &_stat) == 0 && scast<uintmax_t>(_stat.st_size) == _size)
+        {
+            void* _addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(_addr != MAP_FAILED)
+            {
+                const header_t* _hdr    = static_cast<const header_t*>(_addr);
+                const uint32_t* _angles = reinterpret_cast<const uint32_t*>(_hdr + 1);
+                const int32_t*  _data =
+                    reinterpret_cast<const int32_t*>(_angles + _key.angles.size());
+                if(memcmp(_hdr, &_key.header, sizeof(header_t)) == 0 &&
+                   std::equal(_key.angles.begin(), _key.angles.end(), _angles))
+                {
+                    int32_t _n = _key.header.nx * _key.header.ny;
+                    _ret       = pointer(new iarray_t(_data, _data + _n));
+                }
+                munmap(_addr, _size);
+            }
+        }
+        close(fd);
+        return _ret;
+    }
 
-    for(int p = 0; p < dt; ++p)
+    static void store(const key_t& _key, const iarray_t& _sum_dist)
     {
-        float theta_p_rad = fmodf(theta[p] + constants::halfpi, constants::twopi);
-        cxx_rotate_ip(rot, tmp.data(), -theta_p_rad, nx, ny, CPU_NN);
-        compute(rot, sum_dist);
+        std::string _fname = filename(_key.header);
+        if(_fname.empty())
+            return;
+
+        // write to a unique temporary and rename so readers never see a partial file
+        std::stringstream ss;
+        ss << _fname << "." << getpid() << "." << GetThisThreadID() << ".tmp";
+        std::string _tmpname = ss.str();
+
+        int fd = open(_tmpname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0)
+        {
+            fprintf(stderr, "[%lu]> %s : unable to open '%s'\n", GetThisThreadID(),
+                    __FUNCTION__, _tmpname.c_str());
+            return;
+        }
+
+        bool      _success = false;
+        uintmax_t _size    = file_size(_key.header);
+        if(ftruncate(fd, scast<off_t>(_size)) == 0)
+        {
+            void* _addr = mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if(_addr != MAP_FAILED)
+            {
+                header_t* _hdr    = static_cast<header_t*>(_addr);
+                uint32_t* _angles = reinterpret_cast<uint32_t*>(_hdr + 1);
+                memcpy(_hdr, &_key.header, sizeof(header_t));
+                memcpy(_angles, _key.angles.data(),
+                       _key.angles.size() * sizeof(uint32_t));
+                memcpy(_angles + _key.angles.size(), _sum_dist.data(),
+                       _sum_dist.size() * sizeof(int32_t));
+                _success = (msync(_addr, _size, MS_SYNC) == 0);
+                munmap(_addr, _size);
+            }
+        }
+        close(fd);
+
+        if(!_success || rename(_tmpname.c_str(), _fname.c_str()) != 0)
+        {
+            fprintf(stderr, "[%lu]> %s : unable to write '%s'\n", GetThisThreadID(),
+                    __FUNCTION__, _fname.c_str());
+            unlink(_tmpname.c_str());
+        }
     }
+#else
+    static pointer load(const key_t&) { return pointer(); }
+    static void    store(const key_t&, const iarray_t&) {}
+#endif
+
+private:
+    uintmax_t                m_clock = 0;
+    std::map<key_t, entry_t> m_cache;
+};
 
-    return sum_dist;
+//--------------------------------------------------------------------------------------//
+
+// the sum_dist slice of the projection "angles", shared with the cache instead of
+// being expanded to the slices of the volume (the slice is the same for every slice)
+inline SumDistCache::pointer
+cxx_compute_sum_dist(int dx, int nx, int ny, const float* theta, const iarray_t& angles,
+                     TaskManager* man = nullptr)
+{
+    return SumDistCache::instance().get(man, dx, nx, ny, theta, angles);
 }
 
 //======================================================================================//
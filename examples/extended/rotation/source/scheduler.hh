@@ -0,0 +1,183 @@
+// MIT License
+//
+// Copyright (c) 2019 Jonathan R. Madsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+
+#pragma once
+
+#include "macros.hh"
+#include "typedefs.hh"
+
+//======================================================================================//
+//
+//  Reconstruction jobs. With the shared thread-pool (PTL_SHARED_POOL, the default)
+//  every concurrent cxx_mlem/cxx_sirt call is a job on the same pool instead of
+//  creating a pool per calling thread. The projection passes of a job are run by at
+//  most share() tasks that pull projection angles from a counter, share() is the
+//  number of workers divided by the number of active jobs, so the jobs interleave
+//  on the pool at the granularity of a projection and none of them can flood the
+//  task queues.
+//
+//======================================================================================//
+
+class ReconJob
+{
+public:
+    typedef std::atomic<intmax_t> counter_t;
+
+    explicit ReconJob(const std::string& name)
+    : m_name(name)
+    , m_id(active()++)
+    {
+    }
+
+    ~ReconJob() { --active(); }
+
+    ReconJob(const ReconJob&) = delete;
+    ReconJob& operator=(const ReconJob&) = delete;
+
+public:
+    const std::string& name() const { return m_name; }
+    intmax_t           id() const { return m_id; }
+
+    // number of jobs running concurrently
+    static counter_t& active()
+    {
+        static counter_t _instance(0);
+        return _instance;
+    }
+
+    // fair share of "nworkers" for each of the active jobs
+    static intmax_t share(intmax_t nworkers)
+    {
+        return std::max<intmax_t>(nworkers / std::max<intmax_t>(active().load(), 1), 1);
+    }
+
+    // claim up to "ntasks" of the workers in the share of this job (at least one),
+    // the claim is returned with release()
+    intmax_t acquire(intmax_t ntasks, intmax_t nworkers)
+    {
+        intmax_t _avail = share(nworkers) - m_inflight.load();
+        intmax_t _claim = std::max<intmax_t>(std::min(ntasks, _avail), 1);
+        m_inflight += _claim;
+        return _claim;
+    }
+
+    void release(intmax_t nclaim) { m_inflight -= nclaim; }
+
+private:
+    std::string m_name;
+    intmax_t    m_id;
+    counter_t   m_inflight{ 0 };
+};
+
+//======================================================================================//
+//
+//  Buffers shared by the jobs. The update image of a job and the per-task partial
+//  updates are taken from here instead of being allocated for every call and every
+//  projection task. At most PTL_BUFFER_POOL_SIZE bytes (default 1 GiB) are kept.
+//
+//======================================================================================//
+
+class BufferPool
+{
+public:
+    typedef farray_t                           buffer_t;
+    typedef std::multimap<uintmax_t, buffer_t> buffer_map_t;
+
+    static BufferPool& instance()
+    {
+        static BufferPool _instance;
+        return _instance;
+    }
+
+    // a zero-filled buffer of "n" elements
+    buffer_t acquire(uintmax_t n)
+    {
+        buffer_t _buffer;
+        {
+            AutoLock l(TypeMutex<BufferPool>());
+            auto     itr = m_buffers.lower_bound(n);
+            // do not hand out buffers that are much larger than requested
+            if(itr != m_buffers.end() && itr->first <= 2 * n)
+            {
+                _buffer = std::move(itr->second);
+                m_bytes -= itr->first * sizeof(float);
+                m_buffers.erase(itr);
+            }
+        }
+        _buffer.assign(n, 0.0f);
+        return _buffer;
+    }
+
+    void release(buffer_t&& _buffer)
+    {
+        uintmax_t _capacity = _buffer.capacity();
+        AutoLock  l(TypeMutex<BufferPool>());
+        if(_capacity == 0 || m_bytes + _capacity * sizeof(float) > m_max_bytes)
+            return;
+        m_bytes += _capacity * sizeof(float);
+        m_buffers.insert(std::make_pair(_capacity, std::move(_buffer)));
+    }
+
+private:
+    BufferPool()
+    : m_max_bytes(GetEnv<uintmax_t>("PTL_BUFFER_POOL_SIZE", uintmax_t(1) << 30))
+    {
+    }
+
+private:
+    uintmax_t    m_bytes = 0;
+    uintmax_t    m_max_bytes;
+    buffer_map_t m_buffers;
+};
+
+//--------------------------------------------------------------------------------------//
+//  a buffer from the BufferPool that is returned to the pool on destruction
+//
+class PooledBuffer
+{
+public:
+    explicit PooledBuffer(uintmax_t n)
+    : m_buffer(BufferPool::instance().acquire(n))
+    {
+    }
+
+    ~PooledBuffer() { BufferPool::instance().release(std::move(m_buffer)); }
+
+    PooledBuffer(PooledBuffer&& rhs)
+    : m_buffer(std::move(rhs.m_buffer))
+    {
+    }
+
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    float*    data() { return m_buffer.data(); }
+    uintmax_t size() const { return m_buffer.size(); }
+    float&    operator[](uintmax_t i) { return m_buffer[i]; }
+
+private:
+    farray_t m_buffer;
+};
+
+//======================================================================================//
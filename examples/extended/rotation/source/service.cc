@@ -0,0 +1,447 @@
+// MIT License
+//
+// Copyright (c) 2019 Jonathan R. Madsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+
+#include "common.hh"
+#include "cxx_extern.hh"
+#include "service.hh"
+#include "stream.hh"
+
+#if !defined(_WIN32)
+
+#    include <poll.h>
+#    include <sys/socket.h>
+#    include <sys/stat.h>
+#    include <sys/un.h>
+
+//======================================================================================//
+//  read/write exactly "n" bytes
+//
+static bool
+service_read(int fd, void* buf, uintmax_t n)
+{
+    char* _buf = static_cast<char*>(buf);
+    while(n > 0)
+    {
+        ssize_t _n = recv(fd, _buf, n, 0);
+        if(_n < 0 && errno == EINTR)
+            continue;
+        if(_n <= 0)
+            return false;
+        _buf += _n;
+        n -= scast<uintmax_t>(_n);
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------//
+
+static bool
+service_write(int fd, const void* buf, uintmax_t n)
+{
+    const char* _buf = static_cast<const char*>(buf);
+    while(n > 0)
+    {
+        // no SIGPIPE when the other end has gone away
+        ssize_t _n = send(fd, _buf, n, MSG_NOSIGNAL);
+        if(_n < 0 && errno == EINTR)
+            continue;
+        if(_n <= 0)
+            return false;
+        _buf += _n;
+        n -= scast<uintmax_t>(_n);
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------//
+
+static sockaddr_un
+service_address(const std::string& path)
+{
+    sockaddr_un _addr;
+    memset(&_addr, 0, sizeof(_addr));
+    _addr.sun_family = AF_UNIX;
+    if(path.empty() || path.length() >= sizeof(_addr.sun_path))
+        throw std::runtime_error("Invalid socket path: '" + path + "'");
+    memcpy(_addr.sun_path, path.c_str(), path.length());
+    return _addr;
+}
+
+//--------------------------------------------------------------------------------------//
+//  a socket left behind by a service that died is removed, anything else at the
+//  path (a live service or a file that is not a socket) is left alone
+//
+static void
+remove_stale_socket(const std::string& path, const sockaddr_un& addr)
+{
+    struct stat _stat;
+    if(lstat(path.c_str(), &_stat) != 0)
+    {
+        if(errno == ENOENT)
+            return;
+        throw std::runtime_error("Unable to stat '" + path + "' : " + strerror(errno));
+    }
+
+    if(!S_ISSOCK(_stat.st_mode))
+        throw std::runtime_error("'" + path + "' exists and is not a socket");
+
+    int _fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(_fd < 0)
+        throw std::runtime_error(std::string("socket : ") + strerror(errno));
+    int _ret = connect(_fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    int _err = errno;
+    close(_fd);
+
+    if(_ret == 0)
+        throw std::runtime_error("A service is already listening on '" + path + "'");
+    if(_err != ECONNREFUSED)
+        throw std::runtime_error("Unable to probe '" + path + "' : " + strerror(_err));
+    unlink(path.c_str());
+}
+
+//======================================================================================//
+//
+//  The service keeps the process alive between reconstructions and with it the
+//  shared thread-pool, the sum_dist cache (rotate_utils.hh) and the buffer pool
+//  (scheduler.hh), so a job only pays for its own iterations. Each connection
+//  carries one job and is handled on its own thread, concurrent jobs share the
+//  thread-pool as ReconJob's.
+//
+//======================================================================================//
+
+class ReconService
+{
+public:
+    typedef std::chrono::steady_clock clock_type;
+
+    static ReconService& instance()
+    {
+        static ReconService _instance;
+        return _instance;
+    }
+
+    void start(const std::string& path)
+    {
+        AutoLock l(TypeMutex<ReconService>());
+        if(m_fd >= 0)
+            throw std::runtime_error("The service is already running on '" + m_path +
+                                     "'");
+
+        // warm up the thread-pool before the first job
+        auto nthreads = std::max(GetEnv("PTL_NUM_THREADS", HW_CONCURRENCY),
+                                 decltype(HW_CONCURRENCY)(1));
+        TaskRunManager* run_man = cpu_run_manager();
+        init_run_manager(run_man, nthreads);
+
+        sockaddr_un _addr = service_address(path);
+        remove_stale_socket(path, _addr);
+        int _fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(_fd < 0)
+            throw std::runtime_error(std::string("socket : ") + strerror(errno));
+        if(bind(_fd, reinterpret_cast<sockaddr*>(&_addr), sizeof(_addr)) != 0 ||
+           listen(_fd, 16) != 0)
+        {
+            std::string _msg = strerror(errno);
+            close(_fd);
+            throw std::runtime_error("Unable to listen on '" + path + "' : " + _msg);
+        }
+
+        m_fd   = _fd;
+        m_path = path;
+        m_stop.store(false);
+        m_thread = std::thread([this]() { serve(); });
+        printf("[%lu]> %s : listening on '%s'\n", GetThisThreadID(), __FUNCTION__,
+               path.c_str());
+    }
+
+    // block until stop() is called
+    void wait()
+    {
+        std::thread _thread;
+        {
+            AutoLock l(TypeMutex<ReconService>());
+            std::swap(_thread, m_thread);
+        }
+        if(_thread.joinable())
+            _thread.join();
+    }
+
+    // stop accepting jobs and wait for the running jobs to finish
+    void stop()
+    {
+        m_stop.store(true);
+        wait();
+        AutoLock l(m_mutex);
+        m_cv.wait(l, [this]() { return m_active == 0; });
+    }
+
+private:
+    void serve()
+    {
+        while(!m_stop.load())
+        {
+            pollfd _poll = { m_fd, POLLIN, 0 };
+            if(poll(&_poll, 1, 100) <= 0 || !(_poll.revents & POLLIN))
+                continue;
+            int _fd = accept(m_fd, nullptr, nullptr);
+            if(_fd < 0)
+                continue;
+            {
+                AutoLock l(m_mutex);
+                ++m_active;
+            }
+            std::thread([this, _fd]() {
+                handle(_fd);
+                close(_fd);
+                AutoLock l(m_mutex);
+                --m_active;
+                m_cv.notify_all();
+            }).detach();
+        }
+
+        AutoLock l(TypeMutex<ReconService>());
+        close(m_fd);
+        unlink(m_path.c_str());
+        m_fd = -1;
+    }
+
+    void handle(int fd)
+    {
+        auto _start = clock_type::now();
+        auto _send  = [&](int32_t type, int slab, int nslabs, const std::string& what) {
+            ServiceMessage _msg;
+            memset(&_msg, 0, sizeof(_msg));
+            _msg.type    = type;
+            _msg.slab    = slab;
+            _msg.nslabs  = nslabs;
+            _msg.elapsed = std::chrono::duration<double>(clock_type::now() - _start)
+                               .count();
+            strncpy(_msg.what, what.c_str(), sizeof(_msg.what) - 1);
+            return service_write(fd, &_msg, sizeof(_msg));
+        };
+
+        ServiceRequest _req;
+        if(!service_read(fd, &_req, sizeof(_req)))
+            return;
+        if(!_req.valid())
+        {
+            _send(SERVICE_ERROR, 0, 0, "Invalid request");
+            return;
+        }
+
+        farray_t    theta(scast<uintmax_t>(_req.nangles), 0.0f);
+        std::string sinogram(scast<uintmax_t>(_req.sinogram_length), '\0');
+        std::string output(scast<uintmax_t>(_req.output_length), '\0');
+        if(!service_read(fd, theta.data(), theta.size() * sizeof(float)) ||
+           !service_read(fd, &sinogram[0], sinogram.length()) ||
+           !service_read(fd, &output[0], output.length()))
+            return;
+
+        printf("[%lu]> %s : job '%s' -> '%s'\n", GetThisThreadID(), __FUNCTION__,
+               sinogram.c_str(), output.c_str());
+
+        try
+        {
+            // the angles have to match the sinogram
+            StreamHeader  _header;
+            std::ifstream _ifs(sinogram, std::ios::binary);
+            if(!_ifs.read(reinterpret_cast<char*>(&_header), sizeof(_header)) ||
+               !_header.is(StreamHeader::sinogram_magic()))
+                throw std::runtime_error("Invalid sinogram file: " + sinogram);
+            if(_header.dims[1] != _req.nangles)
+                throw std::runtime_error("The number of angles does not match " +
+                                         sinogram);
+            _ifs.close();
+
+            // a failed send means the client has gone so the job is cancelled
+            stream_reconstruct_job(
+                _req.algorithm, sinogram.c_str(), output.c_str(), theta.data(),
+                _req.ngridx, _req.ngridy, _req.num_iter, _req.num_subsets,
+                [&](int slab, int nslabs) {
+                    return _send(SERVICE_PROGRESS, slab, nslabs, "");
+                });
+            _send(SERVICE_DONE, 0, 0, output);
+        }
+        catch(const std::exception& e)
+        {
+            _send(SERVICE_ERROR, 0, 0, e.what());
+        }
+    }
+
+private:
+    int               m_fd     = -1;
+    int               m_active = 0;
+    std::string       m_path;
+    std::atomic<bool> m_stop{ false };
+    std::thread       m_thread;
+    Mutex             m_mutex;
+    Condition         m_cv;
+};
+
+//======================================================================================//
+
+int
+cxx_service_start(const char* socket_path)
+{
+    try
+    {
+        ReconService::instance().start(socket_path);
+    }
+    catch(const std::exception& e)
+    {
+        AutoLock l(TypeMutex<decltype(std::cout)>());
+        std::cerr << "[" << GetThisThreadID() << "] " << __FUNCTION__ << " : " << e.what()
+                  << std::endl;
+        return scast<int>(false);
+    }
+    return scast<int>(true);
+}
+
+//======================================================================================//
+
+int
+cxx_service_run(const char* socket_path)
+{
+    if(!cxx_service_start(socket_path))
+        return scast<int>(false);
+    ReconService::instance().wait();
+    return scast<int>(true);
+}
+
+//======================================================================================//
+
+int
+cxx_service_stop()
+{
+    ReconService::instance().stop();
+    return scast<int>(true);
+}
+
+//======================================================================================//
+
+int
+cxx_service_submit(const char* socket_path, int algorithm, const char* sinogram,
+                   const char* output, const float* theta, int nangles, int ngridx,
+                   int ngridy, int num_iter, int num_subsets,
+                   cxx_service_progress_t progress)
+{
+    int  _fd    = -1;
+    auto _error = [&](const std::string& msg) {
+        if(_fd >= 0)
+            close(_fd);
+        AutoLock l(TypeMutex<decltype(std::cout)>());
+        std::cerr << "[" << GetThisThreadID() << "] cxx_service_submit : " << msg
+                  << std::endl;
+        return scast<int>(false);
+    };
+
+    ServiceRequest _req;
+    memset(&_req, 0, sizeof(_req));
+    memcpy(_req.magic, ServiceRequest::request_magic(),
+           strlen(ServiceRequest::request_magic()));
+    _req.version         = 1;
+    _req.algorithm       = algorithm;
+    _req.ngridx          = ngridx;
+    _req.ngridy          = ngridy;
+    _req.num_iter        = num_iter;
+    _req.num_subsets     = num_subsets;
+    _req.nangles         = nangles;
+    _req.sinogram_length = scast<int32_t>(strlen(sinogram));
+    _req.output_length   = scast<int32_t>(strlen(output));
+    if(!_req.valid())
+        return _error("invalid job parameters");
+
+    try
+    {
+        sockaddr_un _addr = service_address(socket_path);
+        _fd               = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(_fd < 0 || connect(_fd, reinterpret_cast<sockaddr*>(&_addr), sizeof(_addr)))
+            return _error(std::string("unable to connect to '") + socket_path +
+                          "' : " + strerror(errno));
+    }
+    catch(const std::exception& e)
+    {
+        return _error(e.what());
+    }
+
+    if(!service_write(_fd, &_req, sizeof(_req)) ||
+       !service_write(_fd, theta, scast<uintmax_t>(nangles) * sizeof(float)) ||
+       !service_write(_fd, sinogram, scast<uintmax_t>(_req.sinogram_length)) ||
+       !service_write(_fd, output, scast<uintmax_t>(_req.output_length)))
+        return _error("unable to send the job");
+
+    ServiceMessage _msg;
+    while(service_read(_fd, &_msg, sizeof(_msg)))
+    {
+        _msg.what[sizeof(_msg.what) - 1] = '\0';
+        if(_msg.type == SERVICE_PROGRESS)
+        {
+            if(progress)
+                (*progress)(_msg.slab, _msg.nslabs, _msg.elapsed);
+        }
+        else if(_msg.type == SERVICE_DONE)
+        {
+            close(_fd);
+            return scast<int>(true);
+        }
+        else
+            return _error(_msg.what);
+    }
+    return _error("the connection was closed before the job finished");
+}
+
+#else
+
+//======================================================================================//
+
+int
+cxx_service_start(const char*)
+{
+    fprintf(stderr, "cxx_service_start : the service is not supported on Windows\n");
+    return scast<int>(false);
+}
+
+int
+cxx_service_run(const char* socket_path)
+{
+    return cxx_service_start(socket_path);
+}
+
+int
+cxx_service_stop()
+{
+    return scast<int>(false);
+}
+
+int
+cxx_service_submit(const char*, int, const char*, const char*, const float*, int, int,
+                   int, int, int, cxx_service_progress_t)
+{
+    fprintf(stderr, "cxx_service_submit : the service is not supported on Windows\n");
+    return scast<int>(false);
+}
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,107 @@
+// MIT License
+//
+// Copyright (c) 2019 Jonathan R. Madsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+
+#pragma once
+
+#include "macros.hh"
+#include "stream.hh"
+#include "typedefs.hh"
+
+//======================================================================================//
+//
+//  Wire protocol of the reconstruction service (service.cc). Both ends are on the
+//  same host so the structs are sent as-is (native byte order).
+//
+//  client -> server:   ServiceRequest
+//                      float[nangles]          theta
+//                      char[sinogram_length]   path of the sinogram file (stream.hh)
+//                      char[output_length]     path of the output file
+//
+//  server -> client:   ServiceMessage (SERVICE_PROGRESS) after each slab
+//                      ServiceMessage (SERVICE_DONE or SERVICE_ERROR)
+//
+//======================================================================================//
+
+enum ServiceMessageType : int32_t
+{
+    SERVICE_PROGRESS = 0,
+    SERVICE_DONE     = 1,
+    SERVICE_ERROR    = 2
+};
+
+//--------------------------------------------------------------------------------------//
+
+struct ServiceRequest
+{
+    char    magic[8];
+    int32_t version;
+    int32_t algorithm;  // StreamAlgorithm
+    int32_t ngridx;
+    int32_t ngridy;
+    int32_t num_iter;
+    int32_t num_subsets;
+    int32_t nangles;
+    int32_t sinogram_length;
+    int32_t output_length;
+    int32_t reserved[5];
+
+    static constexpr const char* request_magic() { return "PTLJOB"; }
+
+    // upper bounds so a malformed request cannot make the service allocate the
+    // memory of the host
+    static constexpr int32_t max_grid() { return 16384; }
+    static constexpr int32_t max_angles() { return 1 << 20; }
+    static constexpr int32_t max_path() { return 4096; }
+
+    bool valid() const
+    {
+        auto in_range = [](int32_t val, int32_t max_val) {
+            return val > 0 && val <= max_val;
+        };
+        return strncmp(magic, request_magic(), sizeof(magic)) == 0 && version == 1 &&
+               (algorithm == STREAM_MLEM || algorithm == STREAM_SIRT) &&
+               in_range(ngridx, max_grid()) && in_range(ngridy, max_grid()) &&
+               num_iter > 0 && in_range(num_subsets, nangles) &&
+               in_range(nangles, max_angles()) && in_range(sinogram_length, max_path()) &&
+               in_range(output_length, max_path());
+    }
+};
+
+static_assert(sizeof(ServiceRequest) == 64, "ServiceRequest must be 64 bytes");
+
+//--------------------------------------------------------------------------------------//
+
+struct ServiceMessage
+{
+    int32_t type;  // ServiceMessageType
+    int32_t slab;
+    int32_t nslabs;
+    int32_t reserved;
+    double  elapsed;  // seconds since the job was received
+    char    what[104];
+};
+
+static_assert(sizeof(ServiceMessage) == 128, "ServiceMessage must be 128 bytes");
+
+//======================================================================================//
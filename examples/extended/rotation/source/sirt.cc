@@ -22,9 +22,12 @@
 //
 //
 
+#include "checkpoint.hh"
 #include "common.hh"
 #include "constants.hh"
 #include "data.hh"
+#include "multigrid.hh"
+#include "scheduler.hh"
 #include "rotate_utils.hh"
 
 //======================================================================================//
@@ -34,9 +37,10 @@ typedef CpuData::data_array_t data_array_t;
 
 //======================================================================================//
 
-void
+int
 sirt_cpu(const float* data, int dy, int dt, int dx, const float* /*center*/,
-         const float* theta, float* recon, int ngridx, int ngridy, int num_iter);
+         const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+         int num_subsets = 1, ReconCheckpoint* checkpoint = nullptr);
 
 //======================================================================================//
 
@@ -44,71 +48,88 @@ int
 cxx_sirt(const float* data, int dy, int dt, int dx, const float* center,
          const float* theta, float* recon, int ngridx, int ngridy, int num_iter)
 {
-    auto tid = GetThisThreadID();
-    ConsumeParameters(tid);
-    static std::atomic<int> active;
-    int                     count = active++;
+    auto _func = [&]() {
+        return sirt_cpu(data, dy, dt, dx, center, theta, recon, ngridx, ngridy, num_iter);
+    };
+    return run_entry_point(__FUNCTION__, dy, dt, dx, ngridx, ngridy, num_iter, 1, _func);
+}
 
+//======================================================================================//
+
+int
+cxx_ossirt(const float* data, int dy, int dt, int dx, const float* center,
+           const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+           int num_subsets)
+{
+    auto _func = [&]() {
+        return sirt_cpu(data, dy, dt, dx, center, theta, recon, ngridx, ngridy, num_iter,
+                        num_subsets);
+    };
+    return run_entry_point(__FUNCTION__, dy, dt, dx, ngridx, ngridy, num_iter,
+                           num_subsets, _func);
+}
+
+//======================================================================================//
+//
+//  checkpointed reconstruction: the recon and the completed iterations of every slab
+//  are periodically written to "checkpoint" (PTL_CHECKPOINT_INTERVAL) and a call with
+//  an existing checkpoint of the same problem resumes from it. Returns the total
+//  number of iterations completed or -1 on error
+//
+int
+cxx_sirt_resume(const float* data, int dy, int dt, int dx, const float* center,
+                const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+                int num_subsets, const char* checkpoint)
+{
     START_TIMER(cxx_timer);
     TIMEMORY_AUTO_TIMER("");
 
-    printf("[%lu]> %s : nitr = %i, dy = %i, dt = %i, dx = %i, nx = %i, ny = %i\n",
-           GetThisThreadID(), __FUNCTION__, num_iter, dy, dt, dx, ngridx, ngridy);
+    printf("[%lu]> %s : nitr = %i, nsub = %i, dy = %i, dt = %i, dx = %i, nx = %i, ny = "
+           "%i, checkpoint = %s\n",
+           GetThisThreadID(), __FUNCTION__, num_iter, num_subsets, dy, dt, dx, ngridx,
+           ngridy, checkpoint);
 
+    int nitr = 0;
+    try
     {
         TIMEMORY_AUTO_TIMER("");
-        // run_algorithm(sirt_cpu, sirt_cuda, data, dy, dt, dx, center, theta, recon,
-        // ngridx,
-        //              ngridy, num_iter);
-        sirt_cpu(data, dy, dt, dx, center, theta, recon, ngridx, ngridy, num_iter);
+        ReconCheckpoint _checkpoint(checkpoint, CHECKPOINT_SIRT, dy, ngridx, ngridy,
+                                    num_subsets);
+        nitr = sirt_cpu(data, dy, dt, dx, center, theta, recon, ngridx, ngridy,
+                        num_iter, num_subsets, &_checkpoint);
     }
-
-    auto tcount = GetEnv("PTL_PYTHON_THREADS", HW_CONCURRENCY);
-    auto remain = --active;
-    REPORT_TIMER(cxx_timer, __FUNCTION__, count, tcount);
-    if(remain == 0)
+    catch(const std::exception& e)
     {
-        std::stringstream ss;
-        PrintEnv(ss);
-        printf("[%lu] Reporting environment...\n\n%s\n", GetThisThreadID(),
-               ss.str().c_str());
-#if defined(PTL_USE_CUDA)
-        for(int i = 0; i < cuda_device_count(); ++i)
-        {
-            // set the device
-            cudaSetDevice(i);
-            // sync the device
-            cudaDeviceSynchronize();
-            // reset the device
-            cudaDeviceReset();
-        }
-#endif
-    }
-    else
-    {
-        printf("[%lu] Threads remaining: %i...\n", GetThisThreadID(), remain);
+        AutoLock l(TypeMutex<decltype(std::cout)>());
+        std::cerr << "[" << GetThisThreadID() << "] " << __FUNCTION__ << " : "
+                  << e.what() << std::endl;
+        return -1;
     }
 
-    return scast<int>(true);
+    REPORT_TIMER(cxx_timer, __FUNCTION__, 0, 1);
+    return nitr;
 }
 
 //======================================================================================//
 
+template <typename _Sp>
 void
-sirt_cpu_compute_projection(data_array_t& cpu_data, int p, int dy, int dt, int dx, int nx,
-                            int ny, const float* theta)
+sirt_cpu_compute_projection(data_array_t& cpu_data, int p, CpuSlab<_Sp>* slab, int dt,
+                            int dx, int nx, int ny, const float* theta)
 {
-    ConsumeParameters(dy);
     auto cache = cpu_data[GetThisThreadID() % cpu_data.size()];
+    int  dy    = slab->dy();
 
     // calculate some values
-    float    theta_p = fmodf(theta[p] + constants::halfpi, constants::twopi);
-    farray_t tmp_update(dy * nx * ny, 0.0);
+    float        theta_p = fmodf(theta[p] + constants::halfpi, constants::twopi);
+    PooledBuffer tmp_update(scast<uintmax_t>(dy * nx * ny));
+    double       residual = 0.0;
+    double       norm     = 0.0;
 
     for(int s = 0; s < dy; ++s)
     {
-        const float* data  = cache->data() + s * dt * dx;
-        const float* recon = cache->recon() + s * nx * ny;
+        const _Sp*   data  = slab->data() + s * dt * dx;
+        const float* recon = slab->recon() + s * nx * ny;
         auto&        rot   = cache->rot();
         auto&        tmp   = cache->tmp();
 
@@ -124,7 +145,10 @@ sirt_cpu_compute_projection(data_array_t& cpu_data, int p, int dy, int dt, int d
             float sum = 0.0f;
             for(int i = 0; i < nx; ++i)
                 sum += rot[d * nx + i];
-            float upd = (data[p * dx + d] - sum);
+            float val = storage_to_float(data[p * dx + d]);
+            float upd = (val - sum);
+            residual += upd * upd;
+            norm += val * val;
             for(int i = 0; i < nx; ++i)
                 rot[d * nx + i] += upd;
         }
@@ -137,25 +161,20 @@ sirt_cpu_compute_projection(data_array_t& cpu_data, int p, int dy, int dt, int d
             tmp_update[(s * nx * ny) + i] += tmp[i];
     }
 
-    cache->upd_mutex()->lock();
-    for(int s = 0; s < dy; ++s)
-    {
-        // update shared update array
-        float* update = cache->update() + s * nx * ny;
-        float* tmp    = tmp_update.data() + s * nx * ny;
-        for(uintmax_t i = 0; i < scast<uintmax_t>(nx * ny); ++i)
-            update[i] += tmp[i];
-    }
-    cache->upd_mutex()->unlock();
+    // update shared update array
+    slab->accumulate(p, std::move(tmp_update), residual, norm);
 }
 
 //======================================================================================//
 
-void
-sirt_cpu(const float* data, int dy, int dt, int dx, const float* /*center*/,
-         const float* theta, float* recon, int ngridx, int ngridy, int num_iter)
+template <typename _Sp>
+int
+sirt_cpu_storage(const _Sp* data, int dy, int dt, int dx, const float* /*center*/,
+                 const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+                 int num_subsets, ReconCheckpoint* checkpoint)
 {
-    typedef decltype(HW_CONCURRENCY) nthread_type;
+    typedef decltype(HW_CONCURRENCY)            nthread_type;
+    typedef typename CpuSlab<_Sp>::slab_array_t slab_array_t;
 
     printf("[%lu]> %s : nitr = %i, dy = %i, dt = %i, dx = %i, nx = %i, ny = %i\n",
            GetThisThreadID(), __FUNCTION__, num_iter, dy, dt, dx, ngridx, ngridy);
@@ -165,8 +184,10 @@ sirt_cpu(const float* data, int dy, int dt, int dx, const float* /*center*/,
     setenv("OMP_NUM_THREADS", "1", 1);
 
     // compute some properties (expected python threads, max threads, device assignment)
+    // -- the shared thread-pool is used by all the python threads
     auto min_threads = nthread_type(1);
-    auto pythreads   = GetEnv("PTL_PYTHON_THREADS", HW_CONCURRENCY);
+    auto pythreads   = (use_shared_pool()) ? min_threads
+                                         : GetEnv("PTL_PYTHON_THREADS", HW_CONCURRENCY);
     auto max_threads = HW_CONCURRENCY / std::max(pythreads, min_threads);
     auto nthreads    = std::max(GetEnv("PTL_NUM_THREADS", max_threads), min_threads);
 
@@ -175,52 +196,208 @@ sirt_cpu(const float* data, int dy, int dt, int dx, const float* /*center*/,
     init_run_manager(run_man, nthreads);
     TaskManager* task_man = run_man->GetTaskManager();
 
+    // the pool may have been created by another (concurrent) call
+    nthreads = task_man->thread_pool()->size();
+    ReconJob job(__FUNCTION__);
+
     TIMEMORY_AUTO_TIMER("");
 
-    Mutex       upd_mutex;
-    Mutex       sum_mutex;
-    uintmax_t   recon_pixels = scast<uintmax_t>(dy * ngridx * ngridy);
-    farray_t    update(recon_pixels, 0.0f);
-    init_data_t init_data =
-        CpuData::initialize(nthreads, dy, dt, dx, ngridx, ngridy, recon, data,
+    Mutex        upd_mutex;
+    Mutex        sum_mutex;
+    uintmax_t    recon_pixels = scast<uintmax_t>(dy * ngridx * ngridy);
+    PooledBuffer update(recon_pixels);
+    init_data_t  init_data =
+        CpuData::initialize(nthreads, dy, dt, dx, ngridx, ngridy, recon, nullptr,
                             update.data(), &upd_mutex, &sum_mutex);
     data_array_t cpu_data = std::get<0>(init_data);
-    iarray_t     sum_dist = cxx_compute_sum_dist(dy, dt, dx, ngridx, ngridy, theta);
+
+    // the reconstruction is updated after each subset of projection angles and
+    // each subset has its own sensitivity (sum_dist) image, one slice is held since it
+    // is the same for every slice
+    std::vector<iarray_t>              subsets = compute_ordered_subsets(dt, num_subsets);
+    std::vector<SumDistCache::pointer> sum_dist;
+    for(const auto& itr : subsets)
+        sum_dist.push_back(
+            cxx_compute_sum_dist(dx, ngridx, ngridy, theta, itr, task_man));
+
+    // the slices are independent so each slab of slices advances through the
+    // iterations on its own instead of every iteration waiting on all the slices
+    // -- by default the slabs fill the share of the pool of this job
+    // -- in deterministic mode the default does not depend on the pool (one slab)
+    // -- a resumed reconstruction keeps the slabs of its checkpoint
+    int nslabs = GetEnv<int>("PTL_NUM_SLABS",
+                             (use_deterministic()) ? 1 : ReconJob::share(nthreads));
+    if(checkpoint && checkpoint->restored_slabs() > 0)
+        nslabs = checkpoint->restored_slabs();
+    slab_array_t slabs = CpuSlab<_Sp>::partition(nslabs, dy, dt, dx, ngridx, ngridy,
+                                                data, recon, update.data());
+    nslabs             = scast<int>(slabs.size());
+    if(checkpoint)
+        checkpoint->configure(nslabs, task_man->thread_pool());
 
     //----------------------------------------------------------------------------------//
-    for(int i = 0; i < num_iter; i++)
-    {
+    double      tolerance        = GetConvergenceTolerance();
+    bool        verbose          = (GetEnv<int>("PTL_VERBOSE", 0) > 0);
+    const char* func_name        = __FUNCTION__;
+    auto        reconstruct_slab = [&](CpuSlab<_Sp>* slab) {
         START_TIMER(t_start);
         TIMEMORY_AUTO_TIMER();
 
-        // reset global update
-        memset(update.data(), 0, recon_pixels * sizeof(float));
-
-        // sync and reset
-        CpuData::reset(cpu_data);
+        // the iterations restored from the checkpoint are not run again
+        int nitr = (checkpoint) ? checkpoint->restored_iteration(slab->index()) : 0;
+        IterationMetrics metrics;
+        for(int i = nitr; i < num_iter; i++)
+        {
+            // reductions over the subsets of this iteration, the norm of the recon is
+            // the norm after the last subset
+            metrics = IterationMetrics();
+            for(uintmax_t k = 0; k < subsets.size(); ++k)
+            {
+                // execute the loop over the slab and projection angles of the subset
+                if(use_deterministic())
+                    slab->set_order(&subsets[k]);
+                execute<manager_t, data_array_t>(
+                    task_man, &job, subsets[k], std::ref(cpu_data),
+                    sirt_cpu_compute_projection<_Sp>, slab, dt, dx, ngridx, ngridy,
+                    theta);
+
+                // update the slab recon with the slab update and sum_dist and reset
+                // the slab update for the next subset in the same (parallel) pass, the
+                // convergence metrics are reduced in the same pass
+                const int32_t* _sum_dist = sum_dist[k]->data();
+                uintmax_t      _slice    = scast<uintmax_t>(ngridx * ngridy);
+                float*         _update   = slab->update();
+                float*         _recon    = slab->recon();
+                float          _dx       = scast<float>(dx);
+                auto           _apply    = [=](uintmax_t _beg, uintmax_t _end) {
+                    IterationMetrics _metrics;
+                    if(dx == 0)
+                    {
+                        memset(_update + _beg, 0, (_end - _beg) * sizeof(float));
+                        return _metrics;
+                    }
+                    intmax_t _nfail  = 0;
+                    double   _change = 0.0;
+                    double   _norm   = 0.0;
+                    // the slab starts on a slice so the position in the sum_dist
+                    // slice is the position in the slab modulo the slice size
+                    for(uintmax_t _pos = _beg; _pos < _end;)
+                    {
+                        uintmax_t      _off = _pos % _slice;
+                        uintmax_t      _n   = std::min(_end - _pos, _slice - _off);
+                        const int32_t* _sd  = _sum_dist + _off;
+                        float*         _u   = _update + _pos;
+                        float*         _r   = _recon + _pos;
+                        PRAGMA("omp simd reduction(+ : _nfail, _change, _norm)")
+                        for(uintmax_t ii = 0; ii < _n; ++ii)
+                        {
+                            _nfail += (std::isfinite(_u[ii])) ? 0 : 1;
+
+                            bool  _valid = (_sd[ii] != 0 && std::isfinite(_u[ii]));
+                            float _upd   = _u[ii] / scast<float>(_sd[ii]) / _dx;
+                            float _prev  = _r[ii];
+                            _r[ii]       = (_valid) ? _prev + _upd : _prev;
+                            _u[ii]       = 0.0f;
+                            _change += (_r[ii] - _prev) * (_r[ii] - _prev);
+                            _norm += _r[ii] * _r[ii];
+                        }
+                        _pos += _n;
+                    }
+                    _metrics.nfail  = _nfail;
+                    _metrics.change = _change;
+                    _metrics.norm   = _norm;
+                    return _metrics;
+                };
+                auto _metrics =
+                    execute_blocks<IterationMetrics>(task_man, slab->size(), _apply);
+                metrics.nfail += _metrics.nfail;
+                metrics.change += _metrics.change;
+                metrics.norm = _metrics.norm;
+            }
 
-        // execute the loop over slices and projection angles
-        execute<manager_t, data_array_t>(task_man, dt, std::ref(cpu_data),
-                                         sirt_cpu_compute_projection, dy, dt, dx, ngridx,
-                                         ngridy, theta);
+            // the residual was accumulated by the projection tasks
+            metrics.residual = slab->metrics().residual;
+            metrics.data     = slab->metrics().data;
+            slab->metrics()  = IterationMetrics();
+            ++nitr;
 
-        // update the global recon with global update and sum_dist
-        for(uintmax_t ii = 0; ii < recon_pixels; ++ii)
-        {
-            if(sum_dist[ii] != 0.0f && dx != 0 && std::isfinite(update[ii]))
+            if(metrics.nfail > 0)
             {
-                recon[ii] += update[ii] / sum_dist[ii] / scast<float>(dx);
+                printf("[%lu]> %s : slab %i, iteration %i had %li non-finite update "
+                       "values\n",
+                       GetThisThreadID(), func_name, slab->index(), i,
+                       scast<long>(metrics.nfail));
             }
-            else if(!std::isfinite(update[ii]))
+            if(verbose)
             {
-                std::cout << "update[" << ii << "] is not finite : " << update[ii]
-                          << std::endl;
+                printf("[%lu]> %s : slab %i, iteration %i : change = %e, residual = %e\n",
+                       GetThisThreadID(), func_name, slab->index(), i,
+                       metrics.relative_change(), metrics.relative_residual());
             }
+            bool converged = (tolerance > 0.0 && metrics.relative_change() < tolerance);
+            // the snapshot of the slab is written by a pool task while it iterates
+            if(checkpoint)
+                checkpoint->save(slab->index(), recon, nitr,
+                                 converged || nitr == num_iter);
+            if(converged)
+                break;
+        }
+
+        if(nitr < num_iter)
+        {
+            printf("[%lu]> %s : slab %i converged after %i of %i iterations "
+                   "(change = %e, residual = %e)\n",
+                   GetThisThreadID(), func_name, slab->index(), nitr, num_iter,
+                   metrics.relative_change(), metrics.relative_residual());
         }
-        REPORT_TIMER(t_start, "iteration", i, num_iter);
+        REPORT_TIMER(t_start, "slab", slab->index(), nslabs);
+        return nitr;
+    };
+
+    // execute the slabs, the projection tasks of the slabs are nested task-groups. The
+    // number of iterations run is the maximum over the slabs
+    auto           join = [](int& lhs, int rhs) { return (lhs = std::max(lhs, rhs)); };
+    TaskGroup<int> tg(join, task_man->thread_pool());
+    for(auto& itr : slabs)
+    {
+        CpuSlab<_Sp>* _slab = itr.get();
+        tg.run([=, &reconstruct_slab]() { return reconstruct_slab(_slab); });
     }
+    int nitr = tg.join(0);
+    if(checkpoint)
+        checkpoint->wait();
 
     printf("\n");
+    return nitr;
+}
+
+//======================================================================================//
+
+template int
+sirt_cpu_storage<fp16_t>(const fp16_t*, int, int, int, const float*, const float*,
+                         float*, int, int, int, int, ReconCheckpoint*);
+template int
+sirt_cpu_storage<bf16_t>(const bf16_t*, int, int, int, const float*, const float*,
+                         float*, int, int, int, int, ReconCheckpoint*);
+
+//======================================================================================//
+//
+//  the in-memory sinogram is reconstructed in float, the 16-bit storage types are only
+//  used by the streaming reconstructions (cxx_mlem_stream, cxx_sirt_stream) where
+//  the sinogram is read from the file in the type it was written in. Returns the
+//  number of iterations run (the maximum over the slabs), which is less than
+//  "num_iter" when the iterations converge within PTL_CONVERGENCE_TOL.
+//  With PTL_MULTIGRID_LEVELS > 0 the recon is initialized by reconstructions of
+//  downsampled sinograms on coarser grids (see multigrid.hh)
+//
+int
+sirt_cpu(const float* data, int dy, int dt, int dx, const float* center,
+         const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+         int num_subsets, ReconCheckpoint* checkpoint)
+{
+    return multigrid_reconstruct(sirt_cpu_storage<float>, data, dy, dt, dx, center,
+                                 theta, recon, ngridx, ngridy, num_iter, num_subsets,
+                                 checkpoint);
 }
 
 //======================================================================================//
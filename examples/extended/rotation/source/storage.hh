@@ -0,0 +1,108 @@
+// MIT License
+//
+// Copyright (c) 2019 Jonathan R. Madsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+
+#pragma once
+
+#include "macros.hh"
+#include "typedefs.hh"
+
+#if defined(__F16C__)
+#    include <immintrin.h>
+#endif
+
+//======================================================================================//
+//
+//  16-bit storage types. Values are only stored in these types, all arithmetic is
+//  done in float after conversion. fp16 (IEEE half) keeps 11 bits of mantissa but
+//  overflows above 65504, bf16 keeps the float exponent range but only 8 bits of
+//  mantissa. The fp16 conversion uses the F16C instruction when the compiler
+//  targets it (e.g. -march=native) and portable bit-manipulation otherwise.
+//
+//======================================================================================//
+
+struct fp16_t
+{
+    uint16_t bits;
+};
+
+struct bf16_t
+{
+    uint16_t bits;
+};
+
+//======================================================================================//
+//  conversions to float
+//
+inline float
+storage_to_float(float val)
+{
+    return val;
+}
+
+//--------------------------------------------------------------------------------------//
+
+inline float
+storage_to_float(fp16_t val)
+{
+#if defined(__F16C__)
+    return _cvtsh_ss(val.bits);
+#else
+    uint32_t sign = scast<uint32_t>(val.bits & 0x8000) << 16;
+    uint32_t expo = (val.bits >> 10) & 0x1f;
+    uint32_t mant = val.bits & 0x3ff;
+    uint32_t bits = 0;
+    if(expo == 0x1f)  // inf or nan
+        bits = sign | 0x7f800000 | (mant << 13);
+    else if(expo != 0)  // normal
+        bits = sign | ((expo + 112) << 23) | (mant << 13);
+    else if(mant != 0)  // subnormal: normalize the mantissa
+    {
+        expo = 113;
+        while((mant & 0x400) == 0)
+        {
+            mant <<= 1;
+            --expo;
+        }
+        bits = sign | (expo << 23) | ((mant & 0x3ff) << 13);
+    }
+    else  // zero
+        bits = sign;
+    float ret;
+    memcpy(&ret, &bits, sizeof(float));
+    return ret;
+#endif
+}
+
+//--------------------------------------------------------------------------------------//
+
+inline float
+storage_to_float(bf16_t val)
+{
+    uint32_t bits = scast<uint32_t>(val.bits) << 16;
+    float    ret;
+    memcpy(&ret, &bits, sizeof(float));
+    return ret;
+}
+
+//======================================================================================//
@@ -0,0 +1,331 @@
+// MIT License
+//
+// Copyright (c) 2019 Jonathan R. Madsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+
+#include "checkpoint.hh"
+#include "common.hh"
+#include "cxx_extern.hh"
+#include "storage.hh"
+#include "stream.hh"
+
+//======================================================================================//
+
+int
+mlem_cpu(const float* data, int dy, int dt, int dx, const float* center,
+         const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+         int num_subsets, ReconCheckpoint* checkpoint);
+
+int
+sirt_cpu(const float* data, int dy, int dt, int dx, const float* center,
+         const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+         int num_subsets, ReconCheckpoint* checkpoint);
+
+template <typename _Sp>
+int
+mlem_cpu_storage(const _Sp* data, int dy, int dt, int dx, const float* center,
+                 const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+                 int num_subsets, ReconCheckpoint* checkpoint);
+
+template <typename _Sp>
+int
+sirt_cpu_storage(const _Sp* data, int dy, int dt, int dx, const float* center,
+                 const float* theta, float* recon, int ngridx, int ngridy, int num_iter,
+                 int num_subsets, ReconCheckpoint* checkpoint);
+
+//--------------------------------------------------------------------------------------//
+//  the reconstruction for each of the sinogram storage types
+//
+template <typename _Sp>
+using recon_func_t = int (*)(const _Sp*, int, int, int, const float*, const float*,
+                             float*, int, int, int, int, ReconCheckpoint*);
+
+struct ReconFuncs
+{
+    recon_func_t<float>  fp32;
+    recon_func_t<fp16_t> fp16;
+    recon_func_t<bf16_t> bf16;
+};
+
+#if !defined(_WIN32)
+
+//======================================================================================//
+//
+//  The sinogram file is memory-mapped and reconstructed in slabs of
+//  PTL_STREAM_SLAB_SIZE slices. While a slab is reconstructed (on the thread-pool),
+//  the kernel is asked to read-ahead the next slab. Each reconstructed slab is
+//  queued to the AsyncWriter, which writes it to the output file while the next
+//  slab is reconstructed, and the pages of finished slabs are released, so the
+//  resident memory is bounded by a few slabs instead of the full sinogram and
+//  volume. The progress callback is invoked when a slab has been written, if it
+//  returns false the remaining slabs are not reconstructed and an exception is thrown.
+//
+//======================================================================================//
+
+static void
+stream_reconstruct(const ReconFuncs& funcs, const char* func_name, float init_value,
+                   const char* sinogram, const char* output, const float* theta,
+                   int ngridx, int ngridy, int num_iter, int num_subsets,
+                   const stream_progress_t& progress = stream_progress_t())
+{
+    MappedFile   input(sinogram);
+    StreamHeader header;
+    if(input.size() < sizeof(StreamHeader))
+        throw std::runtime_error(std::string("Invalid sinogram file: ") + sinogram);
+    memcpy(&header, input.data(), sizeof(StreamHeader));
+
+    uintmax_t dtype_size = header.dtype_size();
+    if(!header.is(StreamHeader::sinogram_magic()) || dtype_size == 0 ||
+       !header.valid_dims() ||
+       input.size() < sizeof(StreamHeader) + header.count() * dtype_size)
+        throw std::runtime_error(std::string("Invalid sinogram file: ") + sinogram);
+
+    int dy = header.dims[0];
+    int dt = header.dims[1];
+    int dx = header.dims[2];
+
+    uintmax_t    data_slice  = scast<uintmax_t>(dt * dx);
+    uintmax_t    recon_slice = scast<uintmax_t>(ngridx * ngridy);
+    StreamHeader out_header  = StreamHeader::create(
+        StreamHeader::recon_magic(), STREAM_FLOAT32, dy, ngridx, ngridy);
+
+    // the slabs may be written out of order and from several threads, these are
+    // declared before the writer which waits for the writes in flight
+    Mutex             progress_mutex;
+    int               written = 0;
+    std::atomic<bool> cancelled(false);
+    auto              check_cancelled = [&]() {
+        if(cancelled.load())
+            throw std::runtime_error(std::string("Reconstruction cancelled: ") + output);
+    };
+
+    AsyncWriter out(cpu_run_manager(), output,
+                    sizeof(StreamHeader) + dy * recon_slice * sizeof(float),
+                    GetEnv<int>("PTL_STREAM_WRITE_DEPTH", 2));
+    out.write(0, &out_header, sizeof(StreamHeader));
+
+    int slab_size = GetEnv<int>("PTL_STREAM_SLAB_SIZE", 16);
+    slab_size     = std::max(std::min(slab_size, dy), 1);
+    int nslabs    = (dy + slab_size - 1) / slab_size;
+
+    printf("[%lu]> %s : streaming %i slices in %i slabs of %i slices ('%s' -> '%s')\n",
+           GetThisThreadID(), func_name, dy, nslabs, slab_size, sinogram, output);
+
+    // byte ranges of a slab in the input and output files
+    auto input_range = [&](int s0, int ns) {
+        return std::make_pair(sizeof(StreamHeader) + s0 * data_slice * dtype_size,
+                              ns * data_slice * dtype_size);
+    };
+    auto output_range = [&](int s0, int ns) {
+        return std::make_pair(sizeof(StreamHeader) + s0 * recon_slice * sizeof(float),
+                              ns * recon_slice * sizeof(float));
+    };
+
+    input.sequential();
+    input.prefetch(input_range(0, slab_size).first, input_range(0, slab_size).second);
+
+    farray_t converted;
+    for(int i = 0; i < nslabs; ++i)
+    {
+        check_cancelled();
+        START_TIMER(t_start);
+
+        int s0 = i * slab_size;
+        int ns = std::min(slab_size, dy - s0);
+
+        // read-ahead of the next slab while this slab is reconstructed
+        if(i + 1 < nslabs)
+        {
+            int  ns_next = std::min(slab_size, dy - s0 - ns);
+            auto _next   = input_range(s0 + ns, ns_next);
+            input.prefetch(_next.first, _next.second);
+        }
+
+        auto         _in    = input_range(s0, ns);
+        auto         _out   = output_range(s0, ns);
+        const char*  _src   = input.data() + _in.first;
+        const float* data   = reinterpret_cast<const float*>(_src);
+        farray_t     _recon = out.acquire(ns * recon_slice);
+        float*       recon  = _recon.data();
+
+        // float32 and the 16-bit float storage types are used in-place, other types
+        // are converted to a slab buffer
+        std::fill(recon, recon + ns * recon_slice, init_value);
+        if(header.dtype == STREAM_FLOAT16)
+        {
+            (*funcs.fp16)(reinterpret_cast<const fp16_t*>(_src), ns, dt, dx, nullptr,
+                          theta, recon, ngridx, ngridy, num_iter, num_subsets, nullptr);
+        }
+        else if(header.dtype == STREAM_BFLOAT16)
+        {
+            (*funcs.bf16)(reinterpret_cast<const bf16_t*>(_src), ns, dt, dx, nullptr,
+                          theta, recon, ngridx, ngridy, num_iter, num_subsets, nullptr);
+        }
+        else if(header.dtype == STREAM_FLOAT32)
+        {
+            (*funcs.fp32)(data, ns, dt, dx, nullptr, theta, recon, ngridx, ngridy,
+                          num_iter, num_subsets, nullptr);
+        }
+        else
+        {
+            uintmax_t       _n   = ns * data_slice;
+            const double*   _f64 = reinterpret_cast<const double*>(_src);
+            const uint16_t* _u16 = reinterpret_cast<const uint16_t*>(_src);
+            converted.resize(_n);
+            for(uintmax_t j = 0; j < _n; ++j)
+            {
+                converted[j] = (header.dtype == STREAM_FLOAT64) ? scast<float>(_f64[j])
+                                                                : scast<float>(_u16[j]);
+            }
+            (*funcs.fp32)(converted.data(), ns, dt, dx, nullptr, theta, recon, ngridx,
+                          ngridy, num_iter, num_subsets, nullptr);
+        }
+
+        // the slab is written while the next slab is reconstructed
+        out.submit(_out.first, std::move(_recon), [&, nslabs]() {
+            AutoLock l(progress_mutex);
+            ++written;
+            if(progress && !progress(written, nslabs))
+                cancelled.store(true);
+        });
+        input.release(_in.first, _in.second);
+
+        REPORT_TIMER(t_start, "stream slab", i, nslabs);
+    }
+
+    out.finish();
+    check_cancelled();
+    printf("[%lu]> %s : %.4f seconds writing in the background, %.4f seconds waiting "
+           "on the writer\n",
+           GetThisThreadID(), func_name, out.write_time(), out.stall_time());
+}
+
+//======================================================================================//
+
+static int
+stream_reconstruct_wrapper(const ReconFuncs& funcs, const char* func_name,
+                           float init_value, const char* sinogram, const char* output,
+                           const float* theta, int ngridx, int ngridy, int num_iter,
+                           int num_subsets)
+{
+    START_TIMER(cxx_timer);
+    TIMEMORY_AUTO_TIMER("");
+
+    try
+    {
+        stream_reconstruct(funcs, func_name, init_value, sinogram, output, theta, ngridx,
+                           ngridy, num_iter, num_subsets);
+    }
+    catch(const std::exception& e)
+    {
+        AutoLock l(TypeMutex<decltype(std::cout)>());
+        std::cerr << "[" << GetThisThreadID() << "] " << func_name << " : " << e.what()
+                  << std::endl;
+        return scast<int>(false);
+    }
+
+    REPORT_TIMER(cxx_timer, func_name, 0, 1);
+    return scast<int>(true);
+}
+
+#else
+
+//======================================================================================//
+
+static int
+stream_reconstruct_wrapper(const ReconFuncs&, const char* func_name, float, const char*,
+                           const char*, const float*, int, int, int, int)
+{
+    fprintf(stderr, "%s : streaming reconstructions are not supported on Windows\n",
+            func_name);
+    return scast<int>(false);
+}
+
+#endif
+
+//======================================================================================//
+
+static ReconFuncs
+mlem_stream_funcs()
+{
+    return ReconFuncs{ mlem_cpu, mlem_cpu_storage<fp16_t>, mlem_cpu_storage<bf16_t> };
+}
+
+//--------------------------------------------------------------------------------------//
+
+static ReconFuncs
+sirt_stream_funcs()
+{
+    return ReconFuncs{ sirt_cpu, sirt_cpu_storage<fp16_t>, sirt_cpu_storage<bf16_t> };
+}
+
+//======================================================================================//
+
+int
+cxx_mlem_stream(const char* sinogram, const char* output, const float* theta,
+                int ngridx, int ngridy, int num_iter, int num_subsets)
+{
+    return stream_reconstruct_wrapper(mlem_stream_funcs(), __FUNCTION__, 1.0f, sinogram,
+                                      output, theta, ngridx, ngridy, num_iter,
+                                      num_subsets);
+}
+
+//======================================================================================//
+
+int
+cxx_sirt_stream(const char* sinogram, const char* output, const float* theta,
+                int ngridx, int ngridy, int num_iter, int num_subsets)
+{
+    return stream_reconstruct_wrapper(sirt_stream_funcs(), __FUNCTION__, 0.0f, sinogram,
+                                      output, theta, ngridx, ngridy, num_iter,
+                                      num_subsets);
+}
+
+//======================================================================================//
+
+#if !defined(_WIN32)
+
+//======================================================================================//
+//  used by the reconstruction service (service.cc), errors are thrown
+//
+void
+stream_reconstruct_job(int algorithm, const char* sinogram, const char* output,
+                       const float* theta, int ngridx, int ngridy, int num_iter,
+                       int num_subsets, const stream_progress_t& progress)
+{
+    switch(algorithm)
+    {
+        case STREAM_MLEM:
+            stream_reconstruct(mlem_stream_funcs(), "mlem_stream", 1.0f, sinogram, output,
+                               theta, ngridx, ngridy, num_iter, num_subsets, progress);
+            break;
+        case STREAM_SIRT:
+            stream_reconstruct(sirt_stream_funcs(), "sirt_stream", 0.0f, sinogram, output,
+                               theta, ngridx, ngridy, num_iter, num_subsets, progress);
+            break;
+        default: throw std::runtime_error("Unknown reconstruction algorithm");
+    }
+}
+
+#endif
+
+//======================================================================================//
@@ -0,0 +1,443 @@
+// MIT License
+//
+// Copyright (c) 2019 Jonathan R. Madsen
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+//
+
+#pragma once
+
+#include "macros.hh"
+#include "typedefs.hh"
+
+//======================================================================================//
+//
+//  Raw file layout used by the streaming reconstructions: a 64 byte header followed
+//  by the row-major array. Sinograms have dims = { dy, dt, dx } and reconstructions
+//  have dims = { dy, ngridx, ngridy } (always written as float32).
+//
+//======================================================================================//
+
+enum StreamDataType : int32_t
+{
+    STREAM_FLOAT32  = 0,
+    STREAM_FLOAT64  = 1,
+    STREAM_UINT16   = 2,
+    STREAM_FLOAT16  = 3,
+    STREAM_BFLOAT16 = 4
+};
+
+//--------------------------------------------------------------------------------------//
+
+struct StreamHeader
+{
+    char    magic[8];
+    int32_t version;
+    int32_t dtype;
+    int32_t dims[3];
+    int32_t reserved[9];
+
+    static constexpr const char* sinogram_magic() { return "PTLSINO"; }
+    static constexpr const char* recon_magic() { return "PTLRECON"; }
+
+    static StreamHeader create(const char* _magic, int32_t _dtype, int32_t d0,
+                               int32_t d1, int32_t d2)
+    {
+        StreamHeader _hdr;
+        memset(&_hdr, 0, sizeof(StreamHeader));
+        memcpy(_hdr.magic, _magic, std::min(strlen(_magic), sizeof(_hdr.magic)));
+        _hdr.version = 1;
+        _hdr.dtype   = _dtype;
+        _hdr.dims[0] = d0;
+        _hdr.dims[1] = d1;
+        _hdr.dims[2] = d2;
+        return _hdr;
+    }
+
+    bool is(const char* _magic) const
+    {
+        return strncmp(magic, _magic, sizeof(magic)) == 0 && version == 1;
+    }
+
+    uintmax_t dtype_size() const
+    {
+        switch(dtype)
+        {
+            case STREAM_FLOAT32: return sizeof(float);
+            case STREAM_FLOAT64: return sizeof(double);
+            case STREAM_UINT16:
+            case STREAM_FLOAT16:
+            case STREAM_BFLOAT16: return sizeof(uint16_t);
+            default: return 0;
+        }
+    }
+
+    // every dimension must be positive, count() is only meaningful if they are
+    bool valid_dims() const { return dims[0] > 0 && dims[1] > 0 && dims[2] > 0; }
+
+    uintmax_t count() const
+    {
+        return scast<uintmax_t>(dims[0]) * scast<uintmax_t>(dims[1]) *
+               scast<uintmax_t>(dims[2]);
+    }
+};
+
+static_assert(sizeof(StreamHeader) == 64, "StreamHeader must be 64 bytes");
+
+//--------------------------------------------------------------------------------------//
+
+enum StreamAlgorithm : int32_t
+{
+    STREAM_MLEM = 0,
+    STREAM_SIRT = 1
+};
+
+// invoked after each slab with (number of slabs done, number of slabs), returning
+// false cancels the slabs that have not been started
+typedef std::function<bool(int, int)> stream_progress_t;
+
+#if !defined(_WIN32)
+// reconstruct the sinogram file into the output file, throws on errors and when the
+// progress callback cancels the job
+void
+stream_reconstruct_job(int algorithm, const char* sinogram, const char* output,
+                       const float* theta, int ngridx, int ngridy, int num_iter,
+                       int num_subsets, const stream_progress_t& progress);
+#endif
+
+//======================================================================================//
+//
+//  Read-only memory-mapping of a file. The mapping is released and the file closed on
+//  destruction. Errors throw std::runtime_error.
+//
+//======================================================================================//
+
+#if !defined(_WIN32)
+
+class MappedFile
+{
+public:
+    // map an existing file read-only
+    explicit MappedFile(const std::string& fname)
+    : m_fname(fname)
+    {
+        m_fd = open(fname.c_str(), O_RDONLY);
+        if(m_fd < 0)
+            error("unable to open");
+        struct stat _stat;
+        if(fstat(m_fd, &_stat) != 0)
+            error("unable to stat");
+        m_size = scast<uintmax_t>(_stat.st_size);
+        map(PROT_READ, MAP_SHARED);
+    }
+
+    ~MappedFile()
+    {
+        if(m_addr && m_addr != MAP_FAILED)
+            munmap(m_addr, m_size);
+        if(m_fd >= 0)
+            close(m_fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+public:
+    char*     data() const { return static_cast<char*>(m_addr); }
+    uintmax_t size() const { return m_size; }
+
+    // hint that [offset, offset + length) will be needed soon (read-ahead)
+    void prefetch(uintmax_t offset, uintmax_t length) const
+    {
+        advise(offset, length, MADV_WILLNEED);
+#    if defined(POSIX_FADV_WILLNEED)
+        posix_fadvise(m_fd, scast<off_t>(offset), scast<off_t>(length),
+                      POSIX_FADV_WILLNEED);
+#    endif
+    }
+
+    // hint that [offset, offset + length) is no longer needed
+    void release(uintmax_t offset, uintmax_t length) const
+    {
+        advise(offset, length, MADV_DONTNEED);
+#    if defined(POSIX_FADV_DONTNEED)
+        posix_fadvise(m_fd, scast<off_t>(offset), scast<off_t>(length),
+                      POSIX_FADV_DONTNEED);
+#    endif
+    }
+
+    void sequential() const { advise(0, m_size, MADV_SEQUENTIAL); }
+
+private:
+    void map(int prot, int flags)
+    {
+        m_addr = mmap(nullptr, m_size, prot, flags, m_fd, 0);
+        if(m_addr == MAP_FAILED)
+            error("unable to memory-map");
+    }
+
+    void advise(uintmax_t offset, uintmax_t length, int advice) const
+    {
+        auto _range = page_range(offset, length);
+        if(_range.second > 0)
+            madvise(data() + _range.first, _range.second, advice);
+    }
+
+    // madvise requires page-aligned addresses
+    std::pair<uintmax_t, uintmax_t> page_range(uintmax_t offset, uintmax_t length) const
+    {
+        static uintmax_t _page = scast<uintmax_t>(sysconf(_SC_PAGESIZE));
+        uintmax_t        _beg  = std::min(offset, m_size);
+        uintmax_t        _end  = std::min(offset + length, m_size);
+        _beg                   = (_beg / _page) * _page;
+        return std::make_pair(_beg, _end - _beg);
+    }
+
+    void error(const char* msg)
+    {
+        std::stringstream ss;
+        ss << "MappedFile : " << msg << " '" << m_fname << "' : " << strerror(errno);
+        // the destructor is not invoked when the constructor throws
+        if(m_fd >= 0)
+            close(m_fd);
+        m_fd = -1;
+        throw std::runtime_error(ss.str().c_str());
+    }
+
+private:
+    std::string m_fname;
+    int         m_fd   = -1;
+    uintmax_t   m_size = 0;
+    void*       m_addr = nullptr;
+};
+
+#endif
+
+//======================================================================================//
+//
+//  Asynchronous output of the reconstructed slabs. The slabs are reconstructed into
+//  buffers of the writer and submitted to the asynchronous I/O of the task-manager
+//  (io_uring when available, the blocking I/O threads otherwise, see AsyncIO) while
+//  the next slab is reconstructed. There are at most "depth" buffers
+//  (PTL_STREAM_WRITE_DEPTH, default 2) so acquire() blocks when the disk falls behind
+//  and the memory is bounded by "depth" slabs. Write errors are rethrown by finish().
+//
+//======================================================================================//
+
+#if !defined(_WIN32)
+
+class AsyncWriter
+{
+public:
+    typedef std::function<void()>                 callback_t;
+    typedef std::chrono::steady_clock::time_point time_point_t;
+
+    struct Request
+    {
+        uintmax_t    offset;
+        farray_t     buffer;
+        callback_t   callback;
+        uintmax_t    written;
+        time_point_t start;
+    };
+
+public:
+    // the task-manager of "run_man" is used when the buffers are submitted, i.e. after
+    // the first slab has initialized the run manager
+    AsyncWriter(TaskRunManager* run_man, const std::string& fname, uintmax_t size,
+                int depth)
+    : m_run_man(run_man)
+    , m_fname(fname)
+    , m_depth(std::max(depth, 1))
+    {
+        m_fd = open(fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(m_fd < 0)
+            error("unable to create");
+        if(ftruncate(m_fd, scast<off_t>(size)) != 0)
+            error("unable to resize");
+    }
+
+    ~AsyncWriter()
+    {
+        // the continuations of the writes in flight refer to the writer
+        {
+            AutoLock l(m_mutex);
+            m_cv.wait(l, [&]() { return m_inflight == 0; });
+        }
+        close(m_fd);
+    }
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+public:
+    // a buffer of "n" floats, blocks while "depth" buffers are in use
+    farray_t acquire(uintmax_t n)
+    {
+        auto     _start = std::chrono::steady_clock::now();
+        farray_t _buffer;
+        {
+            AutoLock l(m_mutex);
+            m_cv.wait(l, [&]() { return m_inuse < m_depth || !m_error.empty(); });
+            ++m_inuse;
+            if(!m_free.empty())
+            {
+                _buffer = std::move(m_free.back());
+                m_free.pop_back();
+            }
+        }
+        m_stall += std::chrono::steady_clock::now() - _start;
+        _buffer.resize(n);
+        return _buffer;
+    }
+
+    // submit the buffer to be written at "offset" (bytes), "callback" is invoked in
+    // the thread-pool when the buffer has been written
+    void submit(uintmax_t offset, farray_t&& buffer, callback_t callback = callback_t())
+    {
+        Request* _req = new Request{ offset, std::move(buffer), callback, 0,
+                                     std::chrono::steady_clock::now() };
+        TaskManager* _man = m_run_man->GetTaskManager();
+        {
+            AutoLock l(m_mutex);
+            ++m_inflight;
+        }
+        if(!_man)
+        {
+            // no thread-pool to complete the request
+            bool _ok = write_at(_req->offset, _req->buffer.data(),
+                                _req->buffer.size() * sizeof(float));
+            release(_req, (_ok) ? 0 : errno);
+            return;
+        }
+        write_async(_man, _req);
+    }
+
+    // write "n" bytes at "offset" from the calling thread
+    void write(uintmax_t offset, const void* data, uintmax_t n)
+    {
+        if(!write_at(offset, data, n))
+            throw std::runtime_error("AsyncWriter : unable to write '" + m_fname +
+                                     "' : " + strerror(errno));
+    }
+
+    // wait for the submitted buffers and the write-back of the file
+    void finish()
+    {
+        {
+            AutoLock l(m_mutex);
+            m_cv.wait(l, [&]() { return m_inflight == 0; });
+            if(!m_error.empty())
+                throw std::runtime_error(m_error.c_str());
+        }
+        fdatasync(m_fd);
+    }
+
+    // seconds acquire() waited for a buffer and seconds the buffers were in flight
+    double stall_time() const { return m_stall.count(); }
+    double write_time() const { return m_write.count(); }
+
+private:
+    // submit the remainder of the request, the continuation resubmits the rest of a
+    // short write
+    void write_async(TaskManager* _man, Request* _req)
+    {
+        uintmax_t _total = _req->buffer.size() * sizeof(float);
+        char*     _data  = reinterpret_cast<char*>(_req->buffer.data()) + _req->written;
+        _man->async_write(m_fd, _data, _total - _req->written,
+                          _req->offset + _req->written,
+                          [=](AsyncIO::result_type _n) {
+                              if(_n > 0)
+                                  _req->written += scast<uintmax_t>(_n);
+                              if(_n == -EINTR || _n == -EAGAIN ||
+                                 (_n > 0 && _req->written < _total))
+                                  write_async(_man, _req);
+                              else if(_n <= 0)
+                                  release(_req, (_n < 0) ? scast<int>(-_n) : EIO);
+                              else
+                                  release(_req, 0);
+                          });
+    }
+
+    // the request has been written or failed with "err"
+    void release(Request* _req, int err)
+    {
+        std::unique_ptr<Request> _owned(_req);
+        if(err == 0 && _req->callback)
+            _req->callback();
+
+        AutoLock l(m_mutex);
+        m_write += std::chrono::steady_clock::now() - _req->start;
+        if(err != 0 && m_error.empty())
+            m_error =
+                "AsyncWriter : unable to write '" + m_fname + "' : " + strerror(err);
+        m_free.push_back(std::move(_req->buffer));
+        --m_inuse;
+        --m_inflight;
+        // notified with the lock held, the destructor may run as soon as it is released
+        m_cv.notify_all();
+    }
+
+    bool write_at(uintmax_t offset, const void* data, uintmax_t n)
+    {
+        const char* _data = static_cast<const char*>(data);
+        while(n > 0)
+        {
+            ssize_t _n = pwrite(m_fd, _data, n, scast<off_t>(offset));
+            if(_n < 0 && errno == EINTR)
+                continue;
+            if(_n <= 0)
+                return false;
+            _data += _n;
+            offset += _n;
+            n -= scast<uintmax_t>(_n);
+        }
+        return true;
+    }
+
+    void error(const char* msg)
+    {
+        std::stringstream ss;
+        ss << "AsyncWriter : " << msg << " '" << m_fname << "' : " << strerror(errno);
+        // the destructor is not invoked when the constructor throws
+        if(m_fd >= 0)
+            close(m_fd);
+        m_fd = -1;
+        throw std::runtime_error(ss.str().c_str());
+    }
+
+private:
+    TaskRunManager*               m_run_man  = nullptr;
+    std::string                   m_fname;
+    int                           m_fd       = -1;
+    int                           m_depth    = 2;
+    int                           m_inuse    = 0;
+    int                           m_inflight = 0;
+    std::string                   m_error;
+    std::vector<farray_t>         m_free;
+    Mutex                         m_mutex;
+    Condition                     m_cv;
+    std::chrono::duration<double> m_stall{ 0.0 };
+    std::chrono::duration<double> m_write{ 0.0 };
+};
+
+#endif
+
+//======================================================================================//
@@ -245,6 +245,40 @@ def run_pyctest():
     test.SetProperty("RUN_SERIAL", "ON")
     test.SetCommand(construct_command(["./recursive_tasking"], args))
 
+    test = pyctest.test()
+    test.SetName("federation")
+    test.SetProperty("WORKING_DIRECTORY", pyctest.BINARY_DIRECTORY)
+    test.SetProperty("ENVIRONMENT", test_env_settings(
+        "cpu-prof-federation"))
+    test.SetProperty("RUN_SERIAL", "ON")
+    test.SetCommand(construct_command(["./federation"], args))
+
+    if platform.system() != "Windows":
+        test = pyctest.test()
+        test.SetName("event_sources")
+        test.SetProperty("WORKING_DIRECTORY", pyctest.BINARY_DIRECTORY)
+        test.SetProperty("ENVIRONMENT", test_env_settings(
+            "cpu-prof-event-sources"))
+        test.SetProperty("RUN_SERIAL", "ON")
+        test.SetCommand(construct_command(["./event_sources"], args))
+
+        test = pyctest.test()
+        test.SetName("async_io")
+        test.SetProperty("WORKING_DIRECTORY", pyctest.BINARY_DIRECTORY)
+        test.SetProperty("ENVIRONMENT", test_env_settings(
+            "cpu-prof-async-io"))
+        test.SetProperty("RUN_SERIAL", "ON")
+        test.SetCommand(construct_command(["./async_io"], args))
+
+    if platform.system() == "Linux":
+        test = pyctest.test()
+        test.SetName("process_pool")
+        test.SetProperty("WORKING_DIRECTORY", pyctest.BINARY_DIRECTORY)
+        test.SetProperty("ENVIRONMENT", test_env_settings(
+            "cpu-prof-process-pool"))
+        test.SetProperty("RUN_SERIAL", "ON")
+        test.SetCommand(construct_command(["./process_pool"], args))
+
     if args.tbb:
         test = pyctest.test()
         test.SetName("tbb_tasking{}".format(tasking_suffix))
@@ -0,0 +1,494 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+//  Tasking class implementation
+//
+// Class Description:
+//
+// Asynchronous file I/O backends: io_uring (set up through the raw system
+// calls, liburing is not required) and blocking I/O threads
+//
+// ---------------------------------------------------------------
+// Author: Jonathan Madsen (Feb 13th 2018)
+// ---------------------------------------------------------------
+
+#include "PTL/AsyncIO.hh"
+#include "PTL/AutoLock.hh"
+#include "PTL/Utility.hh"
+
+#include <cerrno>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+#    include <io.h>
+#else
+#    include <unistd.h>
+#endif
+
+#if defined(PTL_USE_IO_URING)
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
+#endif
+
+//======================================================================================//
+
+namespace
+{
+//--------------------------------------------------------------------------------------//
+// a blocking pread/pwrite of the request, returns the bytes transferred or -errno
+//
+AsyncIO::result_type
+transfer(AsyncIO::Request* req)
+{
+#if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
+    // no positional I/O, the seek and the transfer are serialized
+    static Mutex _mutex;
+    AutoLock     l(_mutex);
+    if(_lseeki64(req->fd, req->offset, SEEK_SET) < 0)
+        return -errno;
+    int _n = (req->operation == AsyncIO::READ)
+                 ? _read(req->fd, req->buffer, static_cast<unsigned>(req->size))
+                 : _write(req->fd, req->buffer, static_cast<unsigned>(req->size));
+    return (_n < 0) ? -errno : _n;
+#else
+    while(true)
+    {
+        ssize_t _n = (req->operation == AsyncIO::READ)
+                         ? pread(req->fd, req->buffer, req->size, req->offset)
+                         : pwrite(req->fd, req->buffer, req->size, req->offset);
+        if(_n < 0 && errno == EINTR)
+            continue;
+        return (_n < 0) ? -errno : _n;
+    }
+#endif
+}
+}  // namespace
+
+//======================================================================================//
+
+class AsyncIO::Backend
+{
+public:
+    explicit Backend(AsyncIO* _io)
+    : m_io(_io)
+    {
+    }
+    virtual ~Backend() {}
+
+    virtual bool using_io_uring() const = 0;
+    virtual void submit(Request*)       = 0;
+
+    intmax_t pending() const { return m_pending.load(); }
+
+    void wait()
+    {
+        AutoLock l(m_mutex);
+        m_cv.wait(l, [&]() { return m_pending.load() == 0; });
+    }
+
+protected:
+    // called by the I/O threads when a request is done
+    void complete(Request* req, result_type _result)
+    {
+        m_io->complete(req, _result);
+        AutoLock l(m_mutex);
+        --m_pending;
+        m_cv.notify_all();
+    }
+
+protected:
+    AsyncIO*              m_io;
+    std::atomic<intmax_t> m_pending{ 0 };
+    Mutex                 m_mutex;
+    Condition             m_cv;
+};
+
+//======================================================================================//
+//  fallback: "PTL_IO_THREADS" threads executing blocking pread/pwrite
+//
+class ThreadIOBackend : public AsyncIO::Backend
+{
+public:
+    explicit ThreadIOBackend(AsyncIO* _io)
+    : AsyncIO::Backend(_io)
+    {
+        auto _n = std::max<int>(GetEnv<int>("PTL_IO_THREADS", 2), 1);
+        for(int i = 0; i < _n; ++i)
+            m_threads.push_back(std::thread(&ThreadIOBackend::execute, this));
+    }
+
+    virtual ~ThreadIOBackend()
+    {
+        wait();
+        {
+            AutoLock l(m_mutex);
+            m_exit = true;
+            m_cv.notify_all();
+        }
+        for(auto& itr : m_threads)
+            itr.join();
+    }
+
+    virtual bool using_io_uring() const override { return false; }
+
+    virtual void submit(AsyncIO::Request* req) override
+    {
+        AutoLock l(m_mutex);
+        ++m_pending;
+        m_requests.push_back(req);
+        m_cv.notify_all();
+    }
+
+private:
+    void execute()
+    {
+        while(true)
+        {
+            AsyncIO::Request* _req = nullptr;
+            {
+                AutoLock l(m_mutex);
+                m_cv.wait(l, [&]() { return m_exit || !m_requests.empty(); });
+                if(m_requests.empty())
+                    return;
+                _req = m_requests.front();
+                m_requests.pop_front();
+            }
+            complete(_req, transfer(_req));
+        }
+    }
+
+private:
+    bool                          m_exit = false;
+    std::deque<AsyncIO::Request*> m_requests;
+    std::vector<std::thread>      m_threads;
+};
+
+//======================================================================================//
+
+#if defined(PTL_USE_IO_URING)
+
+//======================================================================================//
+//  io_uring: the requests are added to the submission ring by the submitting
+//  thread and one reaper thread waits on the completion ring
+//
+class UringIOBackend : public AsyncIO::Backend
+{
+public:
+    // throws if the ring cannot be created (e.g. seccomp or an old kernel)
+    explicit UringIOBackend(AsyncIO* _io)
+    : AsyncIO::Backend(_io)
+    {
+        unsigned _depth = std::max<unsigned>(GetEnv<unsigned>("PTL_IO_DEPTH", 64), 1);
+        io_uring_params _params;
+        memset(&_params, 0, sizeof(_params));
+        m_fd = static_cast<int>(syscall(__NR_io_uring_setup, _depth, &_params));
+        if(m_fd < 0)
+            throw std::runtime_error("io_uring_setup failed");
+
+        m_sq_size = _params.sq_off.array + _params.sq_entries * sizeof(unsigned);
+        m_cq_size = _params.cq_off.cqes + _params.cq_entries * sizeof(io_uring_cqe);
+        bool _single = false;
+#    if defined(IORING_FEAT_SINGLE_MMAP)
+        _single = (_params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if(_single)
+            m_sq_size = m_cq_size = std::max(m_sq_size, m_cq_size);
+#    endif
+
+        m_sq_ring = map(m_sq_size, IORING_OFF_SQ_RING);
+        m_cq_ring = (_single) ? m_sq_ring : map(m_cq_size, IORING_OFF_CQ_RING);
+        m_sqes    = static_cast<io_uring_sqe*>(
+            map(_params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+        m_nsqes = _params.sq_entries;
+
+        char* _sq  = static_cast<char*>(m_sq_ring);
+        char* _cq  = static_cast<char*>(m_cq_ring);
+        m_sq_head  = reinterpret_cast<unsigned*>(_sq + _params.sq_off.head);
+        m_sq_tail  = reinterpret_cast<unsigned*>(_sq + _params.sq_off.tail);
+        m_sq_mask  = *reinterpret_cast<unsigned*>(_sq + _params.sq_off.ring_mask);
+        m_sq_array = reinterpret_cast<unsigned*>(_sq + _params.sq_off.array);
+        m_cq_head  = reinterpret_cast<unsigned*>(_cq + _params.cq_off.head);
+        m_cq_tail  = reinterpret_cast<unsigned*>(_cq + _params.cq_off.tail);
+        m_cq_mask  = *reinterpret_cast<unsigned*>(_cq + _params.cq_off.ring_mask);
+        m_cqes     = reinterpret_cast<io_uring_cqe*>(_cq + _params.cq_off.cqes);
+        m_capacity = _params.sq_entries;
+
+        m_reaper = std::thread(&UringIOBackend::execute, this);
+    }
+
+    virtual ~UringIOBackend()
+    {
+        wait();
+        // nothing is in the ring so the reaper is waiting for a submission
+        {
+            AutoLock l(m_mutex);
+            m_stop = true;
+            m_cv.notify_all();
+        }
+        m_reaper.join();
+        unmap();
+    }
+
+    virtual bool using_io_uring() const override { return true; }
+
+    virtual void submit(AsyncIO::Request* req) override
+    {
+        uint8_t _op = (req->operation == AsyncIO::READ) ? IORING_OP_READV
+                                                        : IORING_OP_WRITEV;
+        {
+            AutoLock l(m_mutex);
+            // the completion ring cannot overflow with at most "capacity" in flight
+            m_cv.wait(l, [&]() { return m_pending.load() < m_capacity; });
+            ++m_pending;
+            iovec* _iov   = new iovec{ req->buffer, req->size };
+            m_iovecs[req] = std::unique_ptr<iovec>(_iov);
+            if(push(_op, req, _iov))
+            {
+                ++m_in_ring;
+                m_cv.notify_all();
+                return;
+            }
+            m_iovecs.erase(req);
+        }
+        // the ring did not take the request, it is transferred by this thread and
+        // completed (which releases the pending count) as if it came from the ring
+        complete(req, transfer(req));
+    }
+
+private:
+    // the caller holds m_mutex. Returns false if the entry could not be submitted,
+    // the entry is then removed from the submission ring
+    bool push(uint8_t _op, AsyncIO::Request* req, iovec* _iov)
+    {
+        unsigned      _tail = *m_sq_tail;
+        unsigned      _idx  = _tail & m_sq_mask;
+        io_uring_sqe* _sqe  = m_sqes + _idx;
+        memset(_sqe, 0, sizeof(io_uring_sqe));
+        _sqe->opcode     = _op;
+        _sqe->fd         = req->fd;
+        _sqe->addr       = reinterpret_cast<uint64_t>(_iov);
+        _sqe->len        = 1;
+        _sqe->off        = static_cast<uint64_t>(req->offset);
+        _sqe->user_data  = reinterpret_cast<uint64_t>(req);
+        m_sq_array[_idx] = _idx;
+        __atomic_store_n(m_sq_tail, _tail + 1, __ATOMIC_RELEASE);
+
+        while(syscall(__NR_io_uring_enter, m_fd, 1, 0, 0, nullptr, 0) < 0)
+        {
+            if(errno != EINTR && errno != EAGAIN)
+            {
+                std::cerr << "[PTL::AsyncIO]> io_uring_enter failed : "
+                          << strerror(errno) << std::endl;
+                // take the entry back unless the kernel has already consumed it
+                if(__atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) == _tail)
+                {
+                    __atomic_store_n(m_sq_tail, _tail, __ATOMIC_RELEASE);
+                    return false;
+                }
+                break;
+            }
+        }
+        return true;
+    }
+
+    // the reaper only waits on the completion ring while requests are in the ring,
+    // so it never blocks on a completion that will not come (e.g. a submission that
+    // failed and was transferred by the submitting thread)
+    void execute()
+    {
+        std::chrono::milliseconds _backoff(0);
+        while(true)
+        {
+            {
+                AutoLock l(m_mutex);
+                m_cv.wait(l, [&]() { return m_stop || m_in_ring > 0; });
+                if(m_in_ring == 0)
+                    return;
+            }
+
+            long _ret = syscall(__NR_io_uring_enter, m_fd, 0, 1,
+                                IORING_ENTER_GETEVENTS, nullptr, 0);
+            if(_ret < 0 && errno != EINTR)
+            {
+                // back off instead of spinning while the ring keeps failing
+                _backoff = std::min(std::max(2 * _backoff, std::chrono::milliseconds(1)),
+                                    std::chrono::milliseconds(100));
+                std::this_thread::sleep_for(_backoff);
+            }
+            else
+                _backoff = std::chrono::milliseconds(0);
+
+            typedef std::pair<AsyncIO::Request*, int> completion_t;
+            std::vector<completion_t>                 _done;
+
+            unsigned _head = *m_cq_head;
+            unsigned _tail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+            for(; _head != _tail; ++_head)
+            {
+                const io_uring_cqe& _cqe = m_cqes[_head & m_cq_mask];
+                auto _req = reinterpret_cast<AsyncIO::Request*>(_cqe.user_data);
+                _done.push_back(completion_t(_req, _cqe.res));
+            }
+            __atomic_store_n(m_cq_head, _head, __ATOMIC_RELEASE);
+
+            if(!_done.empty())
+            {
+                AutoLock l(m_mutex);
+                for(auto& itr : _done)
+                    m_iovecs.erase(itr.first);
+                m_in_ring -= static_cast<intmax_t>(_done.size());
+            }
+            for(auto& itr : _done)
+                complete(itr.first, itr.second);
+        }
+    }
+
+    void* map(size_t _size, uint64_t _offset)
+    {
+        void* _addr = mmap(nullptr, _size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, m_fd, static_cast<off_t>(_offset));
+        if(_addr == MAP_FAILED)
+        {
+            unmap();
+            throw std::runtime_error("io_uring mmap failed");
+        }
+        return _addr;
+    }
+
+    void unmap()
+    {
+        if(m_sqes)
+            munmap(m_sqes, m_nsqes * sizeof(io_uring_sqe));
+        if(m_cq_ring && m_cq_ring != m_sq_ring)
+            munmap(m_cq_ring, m_cq_size);
+        if(m_sq_ring)
+            munmap(m_sq_ring, m_sq_size);
+        if(m_fd >= 0)
+            close(m_fd);
+        m_sqes    = nullptr;
+        m_cq_ring = nullptr;
+        m_sq_ring = nullptr;
+        m_fd      = -1;
+    }
+
+private:
+    int                                                 m_fd       = -1;
+    intmax_t                                            m_capacity = 0;
+    size_t                                              m_sq_size  = 0;
+    size_t                                              m_cq_size  = 0;
+    unsigned                                            m_nsqes    = 0;
+    void*                                               m_sq_ring  = nullptr;
+    void*                                               m_cq_ring  = nullptr;
+    io_uring_sqe*                                       m_sqes     = nullptr;
+    io_uring_cqe*                                       m_cqes     = nullptr;
+    unsigned*                                           m_sq_head  = nullptr;
+    unsigned*                                           m_sq_tail  = nullptr;
+    unsigned*                                           m_sq_array = nullptr;
+    unsigned*                                           m_cq_head  = nullptr;
+    unsigned*                                           m_cq_tail  = nullptr;
+    unsigned                                            m_sq_mask  = 0;
+    unsigned                                            m_cq_mask  = 0;
+    std::map<AsyncIO::Request*, std::unique_ptr<iovec>> m_iovecs;
+    bool                                                m_stop    = false;
+    intmax_t                                            m_in_ring = 0;
+    std::thread                                         m_reaper;
+};
+
+#endif
+
+//======================================================================================//
+
+AsyncIO::AsyncIO(ThreadPool* _pool)
+: m_pool(_pool)
+{
+#if defined(PTL_USE_IO_URING)
+    if(GetEnv<bool>("PTL_IO_URING", true))
+    {
+        try
+        {
+            m_backend.reset(new UringIOBackend(this));
+        }
+        catch(std::exception&)
+        {
+            // not permitted or not supported by the kernel
+            m_backend.reset();
+        }
+    }
+#endif
+    if(!m_backend)
+        m_backend.reset(new ThreadIOBackend(this));
+}
+
+//======================================================================================//
+
+AsyncIO::~AsyncIO() { m_backend.reset(); }
+
+//======================================================================================//
+
+bool
+AsyncIO::using_io_uring() const
+{
+    return m_backend->using_io_uring();
+}
+
+//======================================================================================//
+
+intmax_t
+AsyncIO::pending() const
+{
+    return m_backend->pending();
+}
+
+//======================================================================================//
+
+void
+AsyncIO::wait()
+{
+    m_backend->wait();
+}
+
+//======================================================================================//
+
+void
+AsyncIO::submit(Request* req)
+{
+    m_backend->submit(req);
+}
+
+//======================================================================================//
+
+void
+AsyncIO::complete(Request* req, result_type _result)
+{
+    req->result  = _result;
+    VTask* _task = req->task;
+    if(m_pool)
+        m_pool->add_task(std::move(_task));
+    else
+    {
+        // no pool: the continuation is executed by the I/O thread
+        (*_task)();
+        delete _task;
+    }
+}
+
+//======================================================================================//
@@ -0,0 +1,288 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+//  Tasking class implementation
+//
+// Class Description:
+//
+// epoll-based event sources polled by the idle workers of a thread-pool
+//
+// ---------------------------------------------------------------
+// Author: Jonathan Madsen (Feb 13th 2018)
+// ---------------------------------------------------------------
+
+#include "PTL/EventSources.hh"
+#include "PTL/AutoLock.hh"
+#include "PTL/Task.hh"
+#include "PTL/ThreadPool.hh"
+#include "PTL/Utility.hh"
+
+#include <cerrno>
+#include <iostream>
+
+#if defined(__linux__)
+#    include <sys/epoll.h>
+#    include <sys/eventfd.h>
+#    include <unistd.h>
+#    define PTL_EVENT_SOURCES_EPOLL
+#endif
+
+//======================================================================================//
+
+#if defined(PTL_EVENT_SOURCES_EPOLL)
+
+namespace
+{
+uint32_t
+to_epoll(uint32_t _events)
+{
+    uint32_t _ret = EPOLLONESHOT;
+    if(_events & EventSources::EVENT_READ)
+        _ret |= EPOLLIN;
+    if(_events & EventSources::EVENT_WRITE)
+        _ret |= EPOLLOUT;
+    return _ret;
+}
+
+uint32_t
+from_epoll(uint32_t _events)
+{
+    uint32_t _ret = 0;
+    if(_events & (EPOLLIN | EPOLLPRI))
+        _ret |= EventSources::EVENT_READ;
+    if(_events & EPOLLOUT)
+        _ret |= EventSources::EVENT_WRITE;
+    if(_events & EPOLLERR)
+        _ret |= EventSources::EVENT_ERROR;
+    if(_events & EPOLLHUP)
+        _ret |= EventSources::EVENT_HANGUP;
+    return _ret;
+}
+}  // namespace
+
+#endif
+
+//======================================================================================//
+
+EventSources::EventSources(ThreadPool* _pool)
+: m_pool(_pool)
+{
+#if defined(PTL_EVENT_SOURCES_EPOLL)
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_wake  = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if(m_epoll >= 0 && m_wake >= 0)
+    {
+        // the wake-up eventfd is the source with id 0
+        epoll_event _ev;
+        _ev.events   = EPOLLIN;
+        _ev.data.u64 = 0;
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wake, &_ev);
+    }
+#endif
+}
+
+//======================================================================================//
+
+EventSources::~EventSources()
+{
+#if defined(PTL_EVENT_SOURCES_EPOLL)
+    if(m_wake >= 0)
+        close(m_wake);
+    if(m_epoll >= 0)
+        close(m_epoll);
+#endif
+}
+
+//======================================================================================//
+
+bool
+EventSources::add(int fd, uint32_t events, handler_t handler)
+{
+#if defined(PTL_EVENT_SOURCES_EPOLL)
+    if(m_epoll < 0 || m_wake < 0)
+        return false;
+
+    {
+        AutoLock l(m_mutex);
+        if(m_fds.find(fd) != m_fds.end())
+            return false;
+
+        uint64_t    _id = m_next++;
+        epoll_event _ev;
+        _ev.events   = to_epoll(events);
+        _ev.data.u64 = _id;
+        if(epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &_ev) != 0)
+            return false;
+
+        m_sources[_id] = Source{ fd, events, handler };
+        m_fds[fd]      = _id;
+        ++m_size;
+    }
+    // no worker polls while there are no sources
+    m_pool->start_event_poller();
+    return true;
+#else
+    ConsumeParameters(fd, events, handler);
+    return false;
+#endif
+}
+
+//======================================================================================//
+
+bool
+EventSources::remove(int fd)
+{
+#if defined(PTL_EVENT_SOURCES_EPOLL)
+    AutoLock l(m_mutex);
+    auto     itr = m_fds.find(fd);
+    if(itr == m_fds.end())
+        return false;
+
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    m_sources.erase(itr->second);
+    m_fds.erase(itr);
+    --m_size;
+    return true;
+#else
+    ConsumeParameters(fd);
+    return false;
+#endif
+}
+
+//======================================================================================//
+
+bool
+EventSources::poll(const predicate_t& _wake)
+{
+#if defined(PTL_EVENT_SOURCES_EPOLL)
+    if(m_size.load() == 0 || m_epoll < 0)
+        return false;
+
+    bool _expected = false;
+    if(!m_polling.compare_exchange_strong(_expected, true))
+        return false;
+
+    // a task added before "m_polling" was set did not wake up this worker
+    if(_wake())
+    {
+        m_polling.store(false);
+        return false;
+    }
+
+    static const int _max = 32;
+    epoll_event      _events[_max];
+    int              _n = 0;
+    do
+    {
+        _n = epoll_wait(m_epoll, _events, _max, -1);
+    } while(_n < 0 && errno == EINTR);
+
+    m_polling.store(false);
+
+    for(int i = 0; i < _n; ++i)
+    {
+        if(_events[i].data.u64 == 0)
+        {
+            uint64_t _count = 0;
+            while(read(m_wake, &_count, sizeof(_count)) > 0)
+            {
+            }
+            m_signaled.store(false);
+        }
+        else
+            dispatch(_events[i].data.u64, from_epoll(_events[i].events));
+    }
+    return true;
+#else
+    ConsumeParameters(_wake);
+    return false;
+#endif
+}
+
+//======================================================================================//
+
+void
+EventSources::wakeup()
+{
+#if defined(PTL_EVENT_SOURCES_EPOLL)
+    if(m_polling.load() && !m_signaled.exchange(true))
+    {
+        uint64_t _one = 1;
+        if(write(m_wake, &_one, sizeof(_one)) < 0)
+            m_signaled.store(false);
+    }
+#endif
+}
+
+//======================================================================================//
+
+void
+EventSources::dispatch(uint64_t id, uint32_t events)
+{
+    handler_t _handler;
+    int       _fd = -1;
+    {
+        AutoLock l(m_mutex);
+        auto     itr = m_sources.find(id);
+        // unregistered after it became ready
+        if(itr == m_sources.end())
+            return;
+        _handler = itr->second.handler;
+        _fd      = itr->second.fd;
+    }
+
+    auto _func = [=]() {
+        try
+        {
+            _handler(_fd, events);
+        }
+        catch(std::exception& e)
+        {
+            std::cerr << "[PTL::EventSources]> handler of fd " << _fd
+                      << " threw: " << e.what() << std::endl;
+        }
+        // report the source again
+        rearm(id);
+    };
+
+    m_pool->add_task(new PackagedTask<void>(_func));
+}
+
+//======================================================================================//
+
+bool
+EventSources::rearm(uint64_t id)
+{
+#if defined(PTL_EVENT_SOURCES_EPOLL)
+    AutoLock l(m_mutex);
+    auto     itr = m_sources.find(id);
+    if(itr == m_sources.end())
+        return false;
+
+    epoll_event _ev;
+    _ev.events   = to_epoll(itr->second.events);
+    _ev.data.u64 = id;
+    return epoll_ctl(m_epoll, EPOLL_CTL_MOD, itr->second.fd, &_ev) == 0;
+#else
+    ConsumeParameters(id);
+    return false;
+#endif
+}
+
+//======================================================================================//
@@ -0,0 +1,143 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+//  Tasking class implementation
+//
+// Class Description:
+//
+// cooperative stealing between the thread-pools of a process
+//
+// ---------------------------------------------------------------
+// Author: Jonathan Madsen (Feb 13th 2018)
+// ---------------------------------------------------------------
+
+#include "PTL/Federation.hh"
+#include "PTL/AutoLock.hh"
+#include "PTL/Globals.hh"
+#include "PTL/ThreadPool.hh"
+
+#include <algorithm>
+
+//======================================================================================//
+
+Federation&
+Federation::instance()
+{
+    static auto* _instance = new Federation();
+    return *_instance;
+}
+
+//======================================================================================//
+
+void
+Federation::add(ThreadPool* _pool)
+{
+    AutoLock l(m_mutex);
+    if(std::find(m_pools.begin(), m_pools.end(), _pool) == m_pools.end())
+        m_pools.push_back(_pool);
+    m_size.store(m_pools.size());
+}
+
+//======================================================================================//
+
+void
+Federation::remove(ThreadPool* _pool)
+{
+    AutoLock l(m_mutex);
+    auto     itr = std::find(m_pools.begin(), m_pools.end(), _pool);
+    if(itr != m_pools.end())
+        m_pools.erase(itr);
+    m_size.store(m_pools.size());
+}
+
+//======================================================================================//
+
+bool
+Federation::contains(ThreadPool* _pool) const
+{
+    AutoLock l(m_mutex);
+    return std::find(m_pools.begin(), m_pools.end(), _pool) != m_pools.end();
+}
+
+//======================================================================================//
+
+size_t
+Federation::size() const
+{
+    return m_size.load();
+}
+
+//======================================================================================//
+
+bool
+Federation::steal(ThreadPool* thief)
+{
+    if(m_size.load() < 2)
+        return false;
+
+    ThreadPool*              _victim = nullptr;
+    ThreadPool::task_pointer _task   = nullptr;
+    {
+        // the victims are visited in turn so one overloaded pool does not starve
+        // the others
+        AutoLock l(m_mutex);
+        size_t   _n = m_pools.size();
+        for(size_t i = 0; i < _n && !_task; ++i)
+        {
+            ThreadPool* _pool = m_pools.at((m_next + i) % _n);
+            if(_pool == thief || !_pool->is_stealable() || !_pool->is_overloaded() ||
+               _pool->state().load() != thread_pool::state::STARTED)
+                continue;
+            _task = _pool->steal_task();
+            if(_task)
+            {
+                _victim = _pool;
+                m_next  = (m_next + i + 1) % _n;
+            }
+        }
+    }
+
+    if(!_task)
+        return false;
+
+    _victim->execute_stolen(_task);
+    return true;
+}
+
+//======================================================================================//
+
+void
+Federation::notify(ThreadPool* victim)
+{
+    if(m_size.load() < 2)
+        return;
+
+    AutoLock l(m_mutex);
+    for(auto& itr : m_pools)
+    {
+        if(itr != victim && itr->idle_threads() > 0)
+        {
+            itr->wake_thief();
+            return;
+        }
+    }
+}
+
+//======================================================================================//
@@ -0,0 +1,177 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+// Tasking class header file
+//
+// Class Description:
+//
+// Asynchronous file I/O for the thread-pool. Reads and writes are submitted
+// to io_uring (Linux, when PTL is built with PTL_USE_IO_URING and the kernel
+// permits it) or to a few blocking I/O threads otherwise, so no worker of the
+// pool blocks in the system call. When a request completes, its continuation
+// is added to the pool as a task and the future of the continuation is
+// returned by async_read/async_write.
+//
+// The result passed to the continuation is the number of bytes transferred
+// or -errno, as for a single pread/pwrite. The buffer must stay valid until
+// the request completes.
+//
+//      PTL_IO_URING    use io_uring when available (default: 1)
+//      PTL_IO_DEPTH    maximum number of requests in flight (default: 64)
+//      PTL_IO_THREADS  number of I/O threads of the fallback (default: 2)
+//
+// ---------------------------------------------------------------
+// Author: Jonathan Madsen (Feb 13th 2018)
+// ---------------------------------------------------------------
+
+#pragma once
+
+#include "PTL/Task.hh"
+#include "PTL/ThreadPool.hh"
+#include "PTL/Threading.hh"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+
+//======================================================================================//
+
+class AsyncIO
+{
+public:
+    typedef AsyncIO     this_type;
+    typedef ThreadPool* pool_pointer;
+    typedef intmax_t    result_type;
+
+    enum Operation
+    {
+        READ  = 0,
+        WRITE = 1
+    };
+
+    // a request in flight, owned by its continuation task
+    struct Request
+    {
+        Operation   operation;
+        int         fd;
+        void*       buffer;
+        size_t      size;
+        int64_t     offset;
+        result_type result;
+        VTask*      task;
+    };
+
+    class Backend;
+
+public:
+    explicit AsyncIO(ThreadPool* _pool);
+    ~AsyncIO();
+
+    AsyncIO(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+public:
+    //------------------------------------------------------------------------//
+    // read "size" bytes at "offset" of "fd" into "buffer", "func(result)" is
+    // executed in the pool when the read completes
+    //------------------------------------------------------------------------//
+    template <typename _Func>
+    auto async_read(int fd, void* buffer, size_t size, int64_t offset, _Func&& func)
+        -> std::future<decltype(func(result_type()))>
+    {
+        return enqueue(READ, fd, buffer, size, offset, std::forward<_Func>(func));
+    }
+    //------------------------------------------------------------------------//
+    std::future<result_type> async_read(int fd, void* buffer, size_t size,
+                                        int64_t offset)
+    {
+        return async_read(fd, buffer, size, offset, [](result_type _n) { return _n; });
+    }
+    //------------------------------------------------------------------------//
+    // write "size" bytes of "buffer" at "offset" of "fd", "func(result)" is
+    // executed in the pool when the write completes
+    //------------------------------------------------------------------------//
+    template <typename _Func>
+    auto async_write(int fd, const void* buffer, size_t size, int64_t offset,
+                     _Func&& func) -> std::future<decltype(func(result_type()))>
+    {
+        return enqueue(WRITE, fd, const_cast<void*>(buffer), size, offset,
+                       std::forward<_Func>(func));
+    }
+    //------------------------------------------------------------------------//
+    std::future<result_type> async_write(int fd, const void* buffer, size_t size,
+                                         int64_t offset)
+    {
+        return async_write(fd, buffer, size, offset, [](result_type _n) { return _n; });
+    }
+    //------------------------------------------------------------------------//
+
+public:
+    // true if the requests are submitted to io_uring
+    bool using_io_uring() const;
+    // number of requests that have not completed
+    intmax_t pending() const;
+    // block until the requests in flight have completed (the continuations may
+    // still be in the pool)
+    void wait();
+
+    pool_pointer thread_pool() const { return m_pool; }
+
+    // add the continuation of a completed request to the pool
+    void complete(Request*, result_type);
+
+private:
+    template <typename _Func>
+    auto enqueue(Operation op, int fd, void* buffer, size_t size, int64_t offset,
+                 _Func&& func) -> std::future<decltype(func(result_type()))>;
+
+    void submit(Request*);
+
+private:
+    pool_pointer             m_pool;
+    std::unique_ptr<Backend> m_backend;
+};
+
+//--------------------------------------------------------------------------------------//
+
+template <typename _Func>
+auto
+AsyncIO::enqueue(Operation op, int fd, void* buffer, size_t size, int64_t offset,
+                 _Func&& func) -> std::future<decltype(func(result_type()))>
+{
+    typedef decltype(func(result_type()))    _Ret;
+    typedef PackagedTask<_Ret>               task_type;
+    typedef typename std::decay<_Func>::type func_type;
+
+    Request*  _req = new Request{ op, fd, buffer, size, offset, 0, nullptr };
+    func_type _func(std::forward<_Func>(func));
+
+    // the task owns the request and is deleted by the pool after execution
+    auto _task = new task_type([_req, _func]() mutable {
+        std::unique_ptr<Request> _owned(_req);
+        return _func(_req->result);
+    });
+    _req->task             = _task;
+    std::future<_Ret> _fut = _task->get_future();
+    submit(_req);
+    return _fut;
+}
+
+//======================================================================================//
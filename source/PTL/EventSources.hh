@@ -0,0 +1,119 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+// Tasking class header file
+//
+// Class Description:
+//
+// File-descriptor event sources (pipes, sockets, eventfds, ...) of a
+// thread-pool. Instead of a thread per source, a worker of the pool that has
+// no task to execute waits on the sources with epoll (one worker at a time,
+// the other idle workers sleep as usual) and every ready source is added to
+// the pool as a task executing its handler. A source is not reported again
+// until its handler has returned, so the handler of a source never runs
+// concurrently with itself. Adding a task to the pool wakes up the polling
+// worker.
+//
+// Event sources require epoll (Linux), add() returns false otherwise.
+//
+// ---------------------------------------------------------------
+// Author: Jonathan Madsen (Feb 13th 2018)
+// ---------------------------------------------------------------
+
+#pragma once
+
+#include "PTL/Threading.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+
+class ThreadPool;
+
+//======================================================================================//
+
+class EventSources
+{
+public:
+    typedef EventSources                       this_type;
+    typedef std::function<void(int, uint32_t)> handler_t;
+    typedef std::function<bool()>              predicate_t;
+
+    // events of a source (bitmask)
+    enum Event : uint32_t
+    {
+        EVENT_READ   = 0x1,
+        EVENT_WRITE  = 0x2,
+        EVENT_ERROR  = 0x4,
+        EVENT_HANGUP = 0x8
+    };
+
+public:
+    explicit EventSources(ThreadPool* _pool);
+    ~EventSources();
+
+    EventSources(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+public:
+    // register "fd" for the "events" (EVENT_READ and/or EVENT_WRITE, errors and
+    // hang-ups are always reported), "handler(fd, events)" is executed in the
+    // pool when the source is ready. Returns false if "fd" is already registered
+    // or cannot be polled
+    bool add(int fd, uint32_t events, handler_t handler);
+    // unregister "fd", a handler of "fd" that was already dispatched may still
+    // be executing when this returns. Returns false if "fd" is not registered
+    bool remove(int fd);
+    // number of registered sources
+    size_t size() const { return m_size.load(); }
+
+public:
+    // called by an idle worker: unless another worker is polling or "_wake"
+    // (tasks are available or the pool state changed) is true, wait for ready
+    // sources and dispatch their handlers. Returns false if it did not poll
+    bool poll(const predicate_t& _wake);
+    // wake up the polling worker
+    void wakeup();
+
+private:
+    struct Source
+    {
+        int       fd;
+        uint32_t  events;
+        handler_t handler;
+    };
+
+    void dispatch(uint64_t id, uint32_t events);
+    bool rearm(uint64_t id);
+
+private:
+    ThreadPool*                m_pool;
+    int                        m_epoll = -1;
+    int                        m_wake  = -1;
+    uint64_t                   m_next  = 1;
+    std::atomic<size_t>        m_size{ 0 };
+    std::atomic<bool>          m_polling{ false };
+    std::atomic<bool>          m_signaled{ false };
+    Mutex                      m_mutex;
+    std::map<uint64_t, Source> m_sources;
+    std::map<int, uint64_t>    m_fds;
+};
+
+//======================================================================================//
@@ -0,0 +1,92 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+// ---------------------------------------------------------------
+// Tasking class header file
+//
+// Class Description:
+//
+// The federation of the thread-pools of a process. A pool joins it with
+// ThreadPool::federate (or PTL_FEDERATE=ON for all the pools): a worker of a
+// federated pool that has no task to execute takes a task of another federated
+// pool that is stealable and has more queued tasks than idle workers, instead
+// of sleeping. A stealable pool that gets a task while all its workers are
+// busy wakes up an idle worker of another pool. The stolen task is executed
+// in the context (ThreadData) of the pool it belongs to.
+//
+// The initialization function of a pool (ThreadPool::set_initialization) is
+// not executed by the workers of the other pools, a pool whose tasks require
+// it should not be stealable.
+//
+// ---------------------------------------------------------------
+// Author: Jonathan Madsen (Feb 13th 2018)
+// ---------------------------------------------------------------
+
+#pragma once
+
+#include "PTL/Threading.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+//======================================================================================//
+
+class Federation
+{
+public:
+    typedef Federation               this_type;
+    typedef std::vector<ThreadPool*> pool_list_t;
+
+public:
+    // the federation of the process
+    static Federation& instance();
+
+    Federation(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+public:
+    void   add(ThreadPool*);
+    void   remove(ThreadPool*);
+    bool   contains(ThreadPool*) const;
+    size_t size() const;
+
+    // called by an idle worker of "thief": execute a task of an overloaded
+    // stealable pool, returns false if there was none
+    bool steal(ThreadPool* thief);
+    // called when the stealable pool "victim" is overloaded: wake up an idle
+    // worker of another pool
+    void notify(ThreadPool* victim);
+
+    // held while a task is taken (e.g. locked around a fork)
+    Mutex& mutex() { return m_mutex; }
+
+private:
+    Federation() = default;
+
+private:
+    mutable Mutex       m_mutex;
+    pool_list_t         m_pools;
+    std::atomic<size_t> m_size{ 0 };
+    size_t              m_next = 0;
+};
+
+//======================================================================================//
@@ -176,6 +176,25 @@ static const short NONINIT = 3;
 
 }  // namespace state
 
+// how the workers are started (PTL_POOL_START)
+namespace start
+{
+static const short EAGER    = 0;  // one after the other by the creating thread
+static const short LAZY     = 1;  // on demand, as tasks queue up
+static const short PARALLEL = 2;  // by the workers themselves, in a tree
+
+}  // namespace start
+
+// what happens to the queued tasks when the pool is destroyed (PTL_SHUTDOWN)
+namespace shutdown
+{
+static const short IMMEDIATE = 0;  // stop once the workers find the queue empty
+static const short DRAIN     = 1;  // the workers execute the queued tasks, then stop
+static const short CANCEL    = 2;  // the queued tasks are cancelled
+static const short BOUNDED   = 3;  // drain for at most a timeout, then cancel
+
+}  // namespace shutdown
+
 }  // namespace thread_pool
 
 //--------------------------------------------------------------------------------------//
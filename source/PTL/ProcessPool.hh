@@ -0,0 +1,187 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+// Tasking class header file
+//
+// Class Description:
+//
+// A pool of forked worker processes servicing a task queue in shared memory,
+// for tasks that may crash (e.g. native kernels given bad input) without
+// taking down the process that submitted them.
+//
+// A task cannot be a closure: it is a fixed-size descriptor holding the id of
+// a function registered with ProcessPool::register_function (before the pool
+// is created, so the workers inherit it) and a copy of a trivially-copyable
+// argument. Larger data is passed through the shared arena of the pool
+// (ProcessPool::allocate), which is mapped at the same address in every
+// process so pointers into it can be part of the argument.
+//
+// ProcessTaskGroup::join blocks until the tasks of the group have completed,
+// like TaskGroup::join, and returns the number of tasks that failed (threw or
+// crashed their worker). A worker that dies is replaced by a new one and a
+// worker that could not be forked is retried by the monitor. While the pool has
+// no worker at all (e.g. a pool size of zero), the queued tasks fail.
+//
+// The process pool requires Linux (process-shared robust mutexes).
+//
+//      PTL_PROCESS_QUEUE_SIZE  maximum number of queued tasks (default: 1024)
+//      PTL_PROCESS_ARENA_SIZE  size of the shared arena in MB (default: 64)
+//
+// ---------------------------------------------------------------
+// Author: Jonathan Madsen (Feb 13th 2018)
+// ---------------------------------------------------------------
+
+#pragma once
+
+#include "PTL/AutoLock.hh"
+#include "PTL/Threading.hh"
+#include "PTL/Utility.hh"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+//======================================================================================//
+
+class ProcessPool
+{
+public:
+    typedef ProcessPool                       this_type;
+    typedef size_t                            size_type;
+    typedef void (*function_t)(void*);
+    typedef std::function<intmax_t(intmax_t)> affinity_func_t;
+
+    // maximum size of the argument of a task
+    static constexpr size_type max_args_size = 256;
+    // maximum number of groups of a pool
+    static constexpr size_type max_groups = 64;
+
+    struct Shared;
+
+public:
+    // register a task function and return its id
+    static int register_function(function_t);
+
+public:
+    ProcessPool(const size_type& pool_size,
+                size_type        arena_size = GetEnv<size_type>("PTL_PROCESS_ARENA_SIZE",
+                                                         64) * 1024 * 1024,
+                bool             _use_affinity = GetEnv<bool>("PTL_CPU_AFFINITY", false),
+                const affinity_func_t& = [](intmax_t i) {
+                    const auto& _cpus = Threading::GetPlacementOrder(
+                        GetEnv<bool>("PTL_ONE_THREAD_PER_CORE", false));
+                    return _cpus.at(i % _cpus.size());
+                });
+    ~ProcessPool();
+
+    ProcessPool(const this_type&) = delete;
+    this_type& operator=(const this_type&) = delete;
+
+public:
+    size_type size() const { return m_pool_size; }
+    // number of workers that were replaced after they died
+    size_type restarts() const { return m_restarts.load(); }
+
+    // memory shared with the workers, released with the pool
+    void* allocate(size_type _bytes);
+    template <typename _Tp>
+    _Tp* allocate(size_type _n)
+    {
+        return static_cast<_Tp*>(allocate(_n * sizeof(_Tp)));
+    }
+
+public:
+    // used by ProcessTaskGroup, the group and the size of the argument (at most
+    // max_args_size) are checked
+    int       acquire_group();
+    void      release_group(int);
+    void      submit(int group, int function, const void* args, size_type size);
+    size_type join(int group);
+
+private:
+    // throws if "_group" is not a group of the pool
+    static void check_group(int _group);
+    bool        spawn(size_type);
+    void        monitor();
+
+private:
+    size_type                m_pool_size;
+    bool                     m_use_affinity;
+    affinity_func_t          m_affinity_func;
+    std::atomic<size_type>   m_restarts{ 0 };
+    std::atomic<bool>        m_alive{ false };
+    Shared*                  m_shared     = nullptr;
+    size_type                m_shared_len = 0;
+    char*                    m_arena      = nullptr;
+    size_type                m_arena_len  = 0;
+    size_type                m_arena_used = 0;
+    Mutex                    m_mutex;
+    std::unique_ptr<Thread>  m_monitor;
+};
+
+//======================================================================================//
+
+class ProcessTaskGroup
+{
+public:
+    typedef ProcessPool::size_type size_type;
+
+public:
+    explicit ProcessTaskGroup(ProcessPool* _pool)
+    : m_pool(_pool)
+    , m_id(_pool->acquire_group())
+    {}
+    // waits for the tasks of the group
+    ~ProcessTaskGroup()
+    {
+        m_pool->join(m_id);
+        m_pool->release_group(m_id);
+    }
+
+    ProcessTaskGroup(const ProcessTaskGroup&) = delete;
+    ProcessTaskGroup& operator=(const ProcessTaskGroup&) = delete;
+
+public:
+    // execute "function(&args)" in a worker process
+    template <typename _Tp>
+    void run(int function, const _Tp& args)
+    {
+        static_assert(std::is_trivially_copyable<_Tp>::value,
+                      "ProcessTaskGroup arguments must be trivially copyable");
+        static_assert(sizeof(_Tp) <= ProcessPool::max_args_size,
+                      "ProcessTaskGroup arguments exceed ProcessPool::max_args_size");
+        m_pool->submit(m_id, function, &args, sizeof(_Tp));
+    }
+    // execute "function(nullptr)" in a worker process
+    void run(int function) { m_pool->submit(m_id, function, nullptr, 0); }
+
+    // wait for the tasks of the group and return the number of tasks that
+    // failed since the last join
+    size_type join() { return m_pool->join(m_id); }
+    void      wait() { join(); }
+
+private:
+    ProcessPool* m_pool;
+    int          m_id;
+};
+
+//======================================================================================//
@@ -82,22 +82,20 @@ public:
     template <typename _Func>
     TBBTaskGroup(_Func&& _join, ThreadPool* _tp = nullptr)
     : base_type(std::forward<_Func>(_join), _tp)
-    , m_tbb_task_group(new tbb_task_group_t)
     {
+        if(!m_tbb_task_group)
+            m_tbb_task_group.reset(new tbb_task_group_t());
     }
     template <typename _Up = _Tp, enable_if_t<std::is_same<_Up, void>::value, int> = 0>
     TBBTaskGroup(ThreadPool* _tp = nullptr)
     : base_type(_tp)
-    , m_tbb_task_group(new tbb_task_group_t)
     {
+        if(!m_tbb_task_group)
+            m_tbb_task_group.reset(new tbb_task_group_t());
     }
 
     // Destructor
-    virtual ~TBBTaskGroup()
-    {
-        delete m_tbb_task_group;
-        this->clear();
-    }
+    virtual ~TBBTaskGroup() { this->clear(); }
 
     // delete copy-construct
     TBBTaskGroup(const this_type&) = delete;
@@ -140,7 +138,7 @@ public:
     {
         auto _task = wrap(std::forward<_Func>(func), std::forward<_Args>(args)...);
         auto _lamb = [=]() { (*_task)(); };
-        m_tbb_task_group->run(_lamb);
+        arena_execute([&]() { m_tbb_task_group->run(_lamb); });
     }
     //------------------------------------------------------------------------//
     template <typename _Func, typename... _Args>
@@ -153,11 +151,13 @@ public:
               enable_if_t<std::is_same<_Up, void>::value, int> = 0>
     void parallel_for(uintmax_t nitr, uintmax_t, _Func&& func, _Args&&... args)
     {
-        tbb::parallel_for(tbb::blocked_range<size_t>(0, nitr),
-                          [&](const tbb::blocked_range<size_t>& range) {
-                              for(size_t i = range.begin(); i != range.end(); ++i)
-                                  func(std::forward<_Args>(args)...);
-                          });
+        arena_execute([&]() {
+            tbb::parallel_for(tbb::blocked_range<size_t>(0, nitr),
+                              [&](const tbb::blocked_range<size_t>& range) {
+                                  for(size_t i = range.begin(); i != range.end(); ++i)
+                                      func(std::forward<_Args>(args)...);
+                              });
+        });
     }
 
 public:
@@ -170,7 +170,7 @@ public:
     virtual void wait() override
     {
         base_type::wait();
-        m_tbb_task_group->wait();
+        arena_execute([&]() { m_tbb_task_group->wait(); });
     }
 
 public:
@@ -205,8 +205,21 @@ public:
     }
 
 protected:
-    // Protected variables
-    tbb_task_group_t* m_tbb_task_group;
+    //------------------------------------------------------------------------//
+    // execute in the arena of the thread-pool (if it uses TBB)
+    template <typename _Func>
+    void arena_execute(_Func&& func)
+    {
+        tbb_task_arena_t* _arena =
+            (this->m_pool) ? this->m_pool->get_task_arena() : nullptr;
+        if(_arena)
+            _arena->execute(std::forward<_Func>(func));
+        else
+            func();
+    }
+
+protected:
+    using base_type::m_tbb_task_group;
     using base_type:: operator++;
     using base_type:: operator--;
     using base_type::m_join;
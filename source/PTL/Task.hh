@@ -89,6 +89,11 @@ public:
     {
         details::apply(std::move(m_ptask), std::move(m_args));
     }
+    virtual void cancel() override
+    {
+        m_ptask = packaged_task_type();
+        this_type::operator--();
+    }
     future_type  get_future() { return m_ptask.get_future(); }
     virtual bool is_native_task() const override { return true; }
 
@@ -158,6 +163,11 @@ public:
         // check returns as true
         this_type::operator--();
     }
+    virtual void cancel() override
+    {
+        m_ptask = packaged_task_type();
+        this_type::operator--();
+    }
 
     virtual bool is_native_task() const override { return true; }
     future_type  get_future() { return m_ptask.get_future(); }
@@ -217,6 +227,11 @@ public:
         // check returns as true
         this_type::operator--();
     }
+    virtual void cancel() override
+    {
+        m_ptask = packaged_task_type();
+        this_type::operator--();
+    }
 
     virtual bool is_native_task() const override { return true; }
     future_type  get_future() { return m_ptask.get_future(); }
@@ -190,6 +190,20 @@ public:
     {
         m_pool->add_task(wrap(std::forward<_Func>(func), std::move(args)...));
     }
+    //------------------------------------------------------------------------//
+    // tasks that block (e.g. on I/O) are executed by the blocking workers of
+    // the pool so they do not occupy the workers sized to the cores
+    template <typename _Func, typename... _Args>
+    void exec_blocking(_Func&& func, _Args&&... args)
+    {
+        m_pool->add_blocking_task(wrap(std::forward<_Func>(func), std::move(args)...));
+    }
+    //------------------------------------------------------------------------//
+    template <typename _Func, typename... _Args>
+    void run_blocking(_Func&& func, _Args&&... args)
+    {
+        m_pool->add_blocking_task(wrap(std::forward<_Func>(func), std::move(args)...));
+    }
 
 protected:
     //------------------------------------------------------------------------//
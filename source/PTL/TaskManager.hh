@@ -30,6 +30,7 @@
 
 #pragma once
 
+#include "PTL/AsyncIO.hh"
 #include "PTL/TBBTaskGroup.hh"
 #include "PTL/Task.hh"
 #include "PTL/TaskGroup.hh"
@@ -67,7 +68,7 @@ public:
     /// get the singleton pointer
     static TaskManager* GetInstance();
     static TaskManager* GetInstanceIfExists();
-    static unsigned     ncores() { return std::thread::hardware_concurrency(); }
+    static unsigned     ncores() { return Threading::GetNumberOfAvailableCores(); }
 
 public:
     //------------------------------------------------------------------------//
@@ -79,8 +80,21 @@ public:
     inline size_type size() const { return m_pool->size(); }
 
     //------------------------------------------------------------------------//
-    // kill all the threads
-    inline void finalize() { m_pool->destroy_threadpool(); }
+    // kill all the threads (after the asynchronous I/O requests have completed)
+    inline void finalize()
+    {
+        m_io.reset();
+        m_pool->destroy_threadpool();
+    }
+    //------------------------------------------------------------------------//
+    // asynchronous file I/O on the thread pool (created on first use)
+    inline AsyncIO* io()
+    {
+        AutoLock l(TypeMutex<AsyncIO>());
+        if(!m_io)
+            m_io.reset(new AsyncIO(m_pool));
+        return m_io.get();
+    }
     //------------------------------------------------------------------------//
 
 public:
@@ -122,6 +136,94 @@ public:
     }
     //------------------------------------------------------------------------//
 
+public:
+    //------------------------------------------------------------------------//
+    // direct insertion of a packaged_task that blocks (e.g. on I/O), executed
+    // by the blocking workers of the pool (see ThreadPool::blocking_pool)
+    //------------------------------------------------------------------------//
+    template <typename _Ret, typename _Func, typename... _Args>
+    std::future<_Ret> async_blocking(_Func&& func, _Args&&... args)
+    {
+        typedef PackagedTask<_Ret, _Args...> task_type;
+        typedef task_type*                   task_pointer;
+
+        task_pointer _ptask =
+            new task_type(std::forward<_Func>(func), std::forward<_Args>(args)...);
+        std::future<_Ret> _f = _ptask->get_future();
+        m_pool->add_blocking_task(_ptask);
+        return _f;
+    }
+    //------------------------------------------------------------------------//
+    template <typename _Ret, typename _Func>
+    std::future<_Ret> async_blocking(_Func&& func)
+    {
+        typedef PackagedTask<_Ret, _Ret> task_type;
+        typedef task_type*               task_pointer;
+
+        task_pointer      _ptask = new task_type(std::forward<_Func>(func));
+        std::future<_Ret> _f     = _ptask->get_future();
+        m_pool->add_blocking_task(_ptask);
+        return _f;
+    }
+    //------------------------------------------------------------------------//
+    // execute a task that blocks in the task-group "tg"
+    template <typename _Ret, typename _Arg, typename _Func, typename... _Args>
+    void exec_blocking(TaskGroup<_Ret, _Arg>& tg, _Func&& func, _Args&&... args)
+    {
+        tg.exec_blocking(std::forward<_Func>(func), std::forward<_Args>(args)...);
+    }
+    //------------------------------------------------------------------------//
+
+public:
+    //------------------------------------------------------------------------//
+    // file-descriptor event sources: "handler(fd, events)" is added to the pool
+    // as a task when "fd" is ready (see EventSources)
+    //------------------------------------------------------------------------//
+    template <typename _Func>
+    bool register_event_source(int fd, uint32_t events, _Func&& handler)
+    {
+        return m_pool->event_sources()->add(fd, events,
+                                            std::forward<_Func>(handler));
+    }
+    //------------------------------------------------------------------------//
+    bool unregister_event_source(int fd)
+    {
+        return m_pool->event_sources()->remove(fd);
+    }
+    //------------------------------------------------------------------------//
+
+public:
+    //------------------------------------------------------------------------//
+    // asynchronous reads/writes, the continuation "func(result)" is added to
+    // the pool when the request completes (see AsyncIO)
+    //------------------------------------------------------------------------//
+    template <typename _Func>
+    auto async_read(int fd, void* buffer, size_t size, int64_t offset, _Func&& func)
+        -> std::future<decltype(func(AsyncIO::result_type()))>
+    {
+        return io()->async_read(fd, buffer, size, offset, std::forward<_Func>(func));
+    }
+    //------------------------------------------------------------------------//
+    std::future<AsyncIO::result_type> async_read(int fd, void* buffer, size_t size,
+                                                 int64_t offset)
+    {
+        return io()->async_read(fd, buffer, size, offset);
+    }
+    //------------------------------------------------------------------------//
+    template <typename _Func>
+    auto async_write(int fd, const void* buffer, size_t size, int64_t offset,
+                     _Func&& func) -> std::future<decltype(func(AsyncIO::result_type()))>
+    {
+        return io()->async_write(fd, buffer, size, offset, std::forward<_Func>(func));
+    }
+    //------------------------------------------------------------------------//
+    std::future<AsyncIO::result_type> async_write(int fd, const void* buffer,
+                                                  size_t size, int64_t offset)
+    {
+        return io()->async_write(fd, buffer, size, offset);
+    }
+    //------------------------------------------------------------------------//
+
 public:
     //------------------------------------------------------------------------//
     // public wrap functions
@@ -218,7 +320,8 @@ public:
 
 protected:
     // Protected variables
-    ThreadPool* m_pool;
+    ThreadPool*              m_pool;
+    std::unique_ptr<AsyncIO> m_io;
 
 private:
     static TaskManager*& fgInstance();
@@ -244,7 +347,7 @@ TaskManager::GetInstance()
 {
     if(!fgInstance())
     {
-        auto nthreads = std::thread::hardware_concurrency();
+        auto nthreads = Threading::GetNumberOfAvailableCores();
         std::cout << "Allocating mad::TaskManager with " << nthreads << " thread(s)..."
                   << std::endl;
         new TaskManager(TaskRunManager::GetMasterRunManager()->GetThreadPool());
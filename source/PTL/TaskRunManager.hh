@@ -66,7 +66,7 @@ public:
 
 public:
     // Inherited methods to re-implement for MT case
-    virtual void Initialize(uint64_t n = std::thread::hardware_concurrency());
+    virtual void Initialize(uint64_t n = Threading::GetNumberOfAvailableCores());
     virtual void Terminate();
     ThreadPool*  GetThreadPool() const { return threadPool; }
     TaskManager* GetTaskManager() const { return taskManager; }
@@ -33,11 +33,13 @@
 
 #if defined(PTL_USE_TBB)
 
+#    include <tbb/global_control.h>
+#    include <tbb/task_arena.h>
 #    include <tbb/task_group.h>
-#    include <tbb/task_scheduler_init.h>
 
-typedef tbb::task_group          tbb_task_group_t;
-typedef tbb::task_scheduler_init tbb_task_scheduler_t;
+typedef tbb::task_group     tbb_task_group_t;
+typedef tbb::task_arena     tbb_task_arena_t;
+typedef tbb::global_control tbb_global_control_t;
 
 #else
 
@@ -64,19 +66,40 @@ public:
     }
 };
 
-class task_scheduler_init
+class task_arena
 {
 public:
     // dummy constructor
-    task_scheduler_init(int = 0, uint64_t = 0) {}
+    task_arena(int = -1, unsigned = 1) {}
     // dummy initialize
-    inline void initialize(int = 0) {}
+    inline void initialize(int = -1, unsigned = 1) {}
+    inline int  max_concurrency() const { return 1; }
+    // execute function
+    template <typename _Func>
+    inline auto execute(_Func f) -> decltype(f())
+    {
+        return f();
+    }
+};
+
+class global_control
+{
+public:
+    enum parameter
+    {
+        max_allowed_parallelism,
+        thread_stack_size
+    };
+    // dummy constructor
+    global_control(parameter, size_t) {}
+    static size_t active_value(parameter) { return 1; }
 };
 
 }  // namespace tbb
 
-typedef tbb::task_group          tbb_task_group_t;
-typedef tbb::task_scheduler_init tbb_task_scheduler_t;
+typedef tbb::task_group     tbb_task_group_t;
+typedef tbb::task_arena     tbb_task_arena_t;
+typedef tbb::global_control tbb_global_control_t;
 
 #endif
 
@@ -95,19 +118,34 @@ public:
     template <typename _Tp>
     using TaskStack = std::deque<_Tp>;
 
+    // the pool of the thread saved by push()
+    struct PoolContext
+    {
+        ThreadPool* pool;
+        bool        is_master;
+        intmax_t    thread_index;
+    };
+
     ThreadData();
     ThreadData(ThreadPool* tp);
     ~ThreadData();
 
     ThreadData& operator=(ThreadPool*);
 
+    // make "tp" the pool of the thread until pop() restores the previous one
+    // (e.g. while it executes the tasks of another pool)
+    void push(ThreadPool* tp);
+    void pop();
+
 public:
     bool                       is_master     = false;
     bool                       within_task   = false;
     intmax_t                   task_depth    = 0;
+    intmax_t                   thread_index  = -1;  // see ThreadPool::get_thread_index
     ThreadPool*                thread_pool   = nullptr;
     VUserTaskQueue*            current_queue = nullptr;
     TaskStack<VUserTaskQueue*> queue_stack;
+    TaskStack<PoolContext>     pool_stack;
 
 public:
     // Public functions
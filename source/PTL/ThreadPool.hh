@@ -35,6 +35,7 @@
 #include <cstdlib>
 #include <cstring>
 // C++
+#include <algorithm>
 #include <atomic>
 #include <deque>
 #include <iostream>
@@ -45,6 +46,8 @@
 #include <vector>
 
 #include "PTL/AutoLock.hh"
+#include "PTL/EventSources.hh"
+#include "PTL/Federation.hh"
 #include "PTL/ThreadData.hh"
 #include "PTL/Threading.hh"
 #include "PTL/VTask.hh"
@@ -78,6 +81,7 @@ public:
     typedef std::vector<bool>                    bool_list_t;
     typedef std::vector<std::unique_ptr<Thread>> thread_pointers_t;
     typedef std::map<ThreadId, uintmax_t>        thread_id_map_t;
+    typedef std::map<ThreadId, intmax_t>         thread_cpu_map_t;
     typedef std::map<uintmax_t, ThreadId>        thread_index_map_t;
     typedef std::function<void()>                initialize_func_t;
     // functions
@@ -88,9 +92,12 @@ public:
     ThreadPool(const size_type& pool_size, VUserTaskQueue* task_queue = nullptr,
                bool _use_affinity     = GetEnv<bool>("PTL_CPU_AFFINITY", false),
                const affinity_func_t& = [](intmax_t) {
+                   // fill the physical cores first, then their SMT siblings
                    static std::atomic<intmax_t> assigned;
                    intmax_t                     _assign = assigned++;
-                   return _assign % Thread::hardware_concurrency();
+                   const auto&                  _cpus   = Threading::GetPlacementOrder(
+                       GetEnv<bool>("PTL_ONE_THREAD_PER_CORE", false));
+                   return _cpus.at(_assign % _cpus.size());
                });
     // Virtual destructors are required by abstract classes
     // so add it by default, just in case
@@ -115,6 +122,8 @@ public:
 public:
     // add tasks for threads to process
     size_type add_task(task_pointer&& task, int bin = -1);
+    // add a task that blocks (e.g. on I/O), it is executed by the blocking workers
+    size_type add_blocking_task(task_pointer&& task);
     // size_type add_thread_task(ThreadId id, task_pointer&& task);
     // add a generic container with iterator
     template <typename _List_t>
@@ -125,8 +134,12 @@ public:
 
     task_queue_t* get_queue() const { return m_task_queue; }
 
-    // only relevant when compiled with PTL_USE_TBB
-    static tbb_task_scheduler_t*& tbb_task_scheduler();
+    // only relevant when compiled with PTL_USE_TBB: the process-wide limit on the
+    // parallelism of TBB (raised for a pool larger than the default) and the
+    // arena of the pool (PTL_TBB_NUMA_NODE constrains it to a NUMA node)
+    static tbb_global_control_t*& tbb_global_control();
+    tbb_task_arena_t*             get_task_arena() const { return m_tbb_task_arena; }
+    bool                          is_tbb_threadpool() const { return m_tbb_tp; }
 
     void set_initialization(initialize_func_t f) { m_init_func = f; }
     void reset_initialization()
@@ -138,8 +151,11 @@ public:
 public:
     // get the pool state
     const pool_state_type& state() const { return m_pool_state; }
-    // see how many main task threads there are
-    size_type size() const { return m_pool_size; }
+    // see how many main task threads there are (including the threads of a
+    // LAZY pool that have not been created yet)
+    size_type size() const { return std::max<size_type>(m_pool_size, m_target_size); }
+    // number of threads that have been created
+    size_type num_started() const { return m_pool_size; }
     // set the thread pool size
     void resize(size_type _n);
     // affinity assigns threads to cores, assignment at constructor
@@ -154,12 +170,62 @@ public:
         return (m_thread_awake) ? m_thread_awake->load() : 0;
     }
 
+    // file-descriptor event sources polled by the idle workers (created on first use)
+    EventSources* event_sources();
+    // used by EventSources: wake up an idle worker to poll (a source was added)
+    void start_event_poller();
+    // the workers executing the blocking tasks: an unpinned pool of at most
+    // PTL_BLOCKING_THREADS (default: twice the size of this pool) threads which
+    // are created as the blocking tasks queue up (created on first use)
+    ThreadPool* blocking_pool();
+    bool        is_blocking_pool() const { return m_parent != nullptr; }
+
+    // federation of the pools of the process (see Federation): the idle workers of
+    // a federated pool execute the tasks of the overloaded stealable pools
+    // leave_federation waits for the tasks of this pool executing on the workers of
+    // other pools, except those on the calling thread. A pool must not be destroyed
+    // by one of its tasks, the process is aborted if a stolen task does it
+    void federate(bool _stealable = true);
+    void leave_federation();
+    bool is_federated() const { return m_federated.load(); }
+    void set_stealable(bool _value) { m_stealable.store(_value); }
+    bool is_stealable() const { return m_stealable.load(); }
+    // number of workers waiting for a task and whether more tasks are queued
+    size_type idle_threads() const;
+    bool      is_overloaded() const { return m_task_queue->size() > idle_threads(); }
+    // used by Federation: take a queued task for a worker of another pool and
+    // execute it on that worker, wake up an idle worker to steal
+    task_pointer steal_task();
+    void         execute_stolen(task_pointer);
+    void         wake_thief();
+
     void set_affinity(affinity_func_t f) { m_affinity_func = f; }
     void set_affinity(intmax_t i, Thread&);
+    // thread_pool::start::EAGER, LAZY or PARALLEL
+    short start_mode() const { return m_start_mode; }
+    // thread_pool::shutdown::IMMEDIATE, DRAIN, CANCEL or BOUNDED (draining for at
+    // most "_timeout" seconds) applied by destroy_threadpool, which returns the
+    // number of queued tasks that were cancelled (no task is left in the queue)
+    void set_shutdown(short _policy, double _timeout = -1.0)
+    {
+        m_shutdown = _policy;
+        if(_timeout >= 0.0)
+            m_shutdown_timeout = _timeout;
+        ThreadPool* _blocking = m_blocking_pool.load();
+        if(_blocking)
+            _blocking->set_shutdown(_policy, _timeout);
+    }
+    short shutdown_policy() const { return m_shutdown; }
 
     void SetVerbose(int n) { m_verbose = n; }
     int  GetVerbose() const { return m_verbose; }
     bool is_master() const { return ThisThread::get_id() == m_master_tid; }
+    // index of a thread in this pool: 0 for the thread that created the pool,
+    // 1..size() for the workers and -1 for the other threads
+    intmax_t get_thread_index(ThreadId _tid = ThisThread::get_id()) const;
+    // indices in this pool (see get_thread_index) of the threads of this pool pinned
+    // to the SMT siblings of the CPU this thread is pinned to
+    const std::vector<uintmax_t>& get_sibling_thread_indices() const;
 
 public:
     // read FORCE_NUM_THREADS environment variable
@@ -173,13 +239,40 @@ protected:
 
 protected:
     // called in THREAD INIT
-    static void start_thread(ThreadPool*, intmax_t = -1);
+    static void start_thread(ThreadPool*, intmax_t = -1, intmax_t = -1);
+    // create worker "i", returns false if the thread could not be created
+    bool create_thread(size_type i);
+    // create the thread of worker "i" (without a lock) and add it to the pool (with
+    // m_start_lock held), split so that PARALLEL does not create under the lock
+    std::unique_ptr<Thread> spawn_thread(size_type i);
+    bool                    register_thread(std::unique_ptr<Thread>&&);
+    // create the workers started by worker "r" (PARALLEL)
+    void start_children(intmax_t r);
+    // create a worker if the tasks queue up (LAZY)
+    void grow();
+    void pin_thread(intmax_t i, NativeThread, ThreadId);
+    // wake up the worker polling the event sources (if any)
+    void wake_event_poller();
+
+protected:
+    // pthread_atfork handlers: the live pools are quiesced (no thread in the middle
+    // of creating a worker, queueing or picking a task) before a fork. The child
+    // only has the forking thread so its pools forget the workers of the parent
+    // and create new ones when a task is added
+    static void fork_prepare();
+    static void fork_parent();
+    static void fork_child();
+    void        prepare_fork();
+    void        resume_after_fork(bool _child);
 
 private:
     // Private variables
     // random
     bool             m_use_affinity;
     bool             m_tbb_tp;
+    short            m_start_mode;
+    short            m_shutdown;
+    double           m_shutdown_timeout;
     atomic_bool_type m_alive_flag;
     int              m_verbose;
     size_type        m_pool_size;
@@ -189,10 +282,25 @@ private:
 
     // locks
     lock_t m_task_lock;
+    lock_t m_start_lock;
     // conditions
     condition_t m_task_cond;
+    condition_t m_start_cond;
+
+    // startup: number of workers to start (LAZY) and the workers that create
+    // the others (PARALLEL)
+    std::atomic<size_type> m_target_size{ 0 };
+    std::atomic<size_type> m_start_first{ 0 };
+    std::atomic<size_type> m_start_count{ 0 };
+    size_type              m_start_fanout = 8;
+    size_type              m_start_done   = 0;
+    uintmax_t              m_start_index  = 0;
+
+    // number of tasks being executed by the workers
+    std::atomic<intmax_t> m_executing{ 0 };
 
     // containers
+    thread_id_map_t   m_thread_ids;      // index of the threads in this pool
     bool_list_t       m_is_joined;       // join list
     bool_list_t       m_is_stopped;      // lets thread know to stop
     thread_list_t     m_main_threads;    // storage for active threads
@@ -202,21 +310,53 @@ private:
     // task queue
     task_queue_t*     m_task_queue;
     tbb_task_group_t* m_tbb_task_group;
+    tbb_task_arena_t* m_tbb_task_arena;
 
     // functions
     initialize_func_t m_init_func;
     affinity_func_t   m_affinity_func;
 
+    // event sources
+    std::atomic<EventSources*> m_event_sources{ nullptr };
+    std::atomic<bool>          m_poll_wake{ false };
+
+    // fork: the pool was quiesced for a fork and the workers have to be
+    // re-created (in the child)
+    bool                   m_forking = false;
+    std::atomic<bool>      m_respawn{ false };
+
+    // federation: the tasks of this pool executed by the workers of other pools
+    // and an idle worker was asked to steal
+    std::atomic<bool>     m_federated{ false };
+    std::atomic<bool>     m_stealable{ false };
+    std::atomic<bool>     m_steal_wake{ false };
+    std::atomic<intmax_t> m_stolen{ 0 };
+
+    // blocking workers (m_parent is the pool the blocking pool belongs to)
+    std::atomic<ThreadPool*> m_blocking_pool{ nullptr };
+    ThreadPool*              m_parent = nullptr;
+
 private:
     // Private static variables
-    static thread_id_map_t f_thread_ids;
-    static bool            f_use_tbb;
+    static thread_id_map_t  f_thread_ids;
+    static thread_cpu_map_t f_thread_cpus;
+    static atomic_int_type  f_thread_generation;
+    static bool             f_use_tbb;
 };
 
+//--------------------------------------------------------------------------------------//
+inline void
+ThreadPool::wake_event_poller()
+{
+    EventSources* _events = m_event_sources.load();
+    if(_events)
+        _events->wakeup();
+}
 //--------------------------------------------------------------------------------------//
 inline void
 ThreadPool::notify()
 {
+    wake_event_poller();
     // wake up one thread that is waiting for a task to be available
     if(m_thread_awake && m_thread_awake->load() < m_pool_size)
     {
@@ -229,6 +369,7 @@ inline void
 ThreadPool::notify_all()
 {
     // wake all threads
+    wake_event_poller();
     AutoLock l(m_task_lock);
     m_task_cond.notify_all();
 }
@@ -239,6 +380,8 @@ ThreadPool::notify(size_type ntasks)
     if(ntasks == 0)
         return;
 
+    wake_event_poller();
+
     // wake up as many threads that tasks just added
     if(m_thread_awake && m_thread_awake->load() < m_pool_size)
     {
@@ -253,18 +396,18 @@ ThreadPool::notify(size_type ntasks)
     }
 }
 //--------------------------------------------------------------------------------------//
-// local function for getting the tbb task scheduler
-inline tbb_task_scheduler_t*&
-ThreadPool::tbb_task_scheduler()
+// local function for getting the tbb global control
+inline tbb_global_control_t*&
+ThreadPool::tbb_global_control()
 {
-    ThreadLocalStatic tbb_task_scheduler_t* _instance = nullptr;
+    static tbb_global_control_t* _instance = nullptr;
     return _instance;
 }
 //--------------------------------------------------------------------------------------//
 inline void
 ThreadPool::resize(size_type _n)
 {
-    if(_n == m_pool_size)
+    if(_n == m_pool_size || _n == m_target_size.load())
         return;
     initialize_threadpool(_n);
     m_task_queue->resize(static_cast<intmax_t>(_n));
@@ -274,16 +417,28 @@ inline int
 ThreadPool::run_on_this(task_pointer&& task)
 {
     auto _func = [=]() {
+        bool _owned = (task->group() == nullptr);
         (*task)();
-        if(!task->group())
+        if(_owned)
             delete task;
     };
 
-    if(m_tbb_tp && m_tbb_task_group)
+#if defined(PTL_USE_TBB)
+    if(m_tbb_tp && m_tbb_task_arena)
     {
-        m_tbb_task_group->run(_func);
+        // executed in the arena of the pool, by the task_group of its task-group
+        // so VTaskGroup::wait takes part in the execution. The task is isolated:
+        // a task-group joined by the task only executes its own tasks meanwhile
+        VTaskGroup*       _group     = task->group();
+        tbb_task_group_t* _tbb_group = (_group && _group->tbb_task_group())
+                                           ? _group->tbb_task_group()
+                                           : m_tbb_task_group;
+        m_tbb_task_arena->execute([&]() {
+            _tbb_group->run([=]() { tbb::this_task_arena::isolate(_func); });
+        });
     }
     else
+#endif
     {
         _func();
     }
@@ -299,6 +454,12 @@ ThreadPool::insert(const task_pointer& task, int bin)
     // pass the task to the queue
     auto ibin = m_task_queue->InsertTask(task, _data.get(), bin);
     notify();
+    if(m_target_size.load() > m_pool_size)
+        grow();
+    // all the workers are busy, a worker of another pool can help
+    if(m_stealable.load(std::memory_order_relaxed) &&
+       m_federated.load(std::memory_order_relaxed) && is_overloaded())
+        Federation::instance().notify(this);
     return ibin;
 }
 //--------------------------------------------------------------------------------------//
@@ -316,6 +477,16 @@ ThreadPool::add_task(task_pointer&& task, int bin)
     return static_cast<size_type>(insert(std::forward<task_pointer>(task), bin));
 }
 //--------------------------------------------------------------------------------------//
+inline ThreadPool::size_type
+ThreadPool::add_blocking_task(task_pointer&& task)
+{
+    // without a thread-pool (or with TBB) there is no separate class of workers
+    if(m_parent || m_tbb_tp || !m_alive_flag.load())
+        return add_task(std::forward<task_pointer>(task));
+
+    return blocking_pool()->add_task(std::forward<task_pointer>(task));
+}
+//--------------------------------------------------------------------------------------//
 template <typename _List_t>
 inline ThreadPool::size_type
 ThreadPool::add_tasks(_List_t& c)
@@ -344,6 +515,8 @@ ThreadPool::add_tasks(_List_t& c)
 
     // notify sleeping threads
     notify(c_size);
+    if(m_target_size.load() > m_pool_size)
+        grow();
 
     return c_size;
 }
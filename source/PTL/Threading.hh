@@ -216,6 +216,23 @@ Pid_t
 GetPidId();
 unsigned
 GetNumberOfCores();
+// CPUs the process may run on: the affinity mask of the process restricted to
+// the cpuset of its cgroup
+const std::vector<int>&
+GetAvailableCpus();
+// number of CPUs the process can use: the available CPUs bounded by the CPU
+// quota of its cgroup (cpu.max or cpu.cfs_quota_us), rounded up, and by the
+// number of physical cores when PTL_ONE_THREAD_PER_CORE is set
+unsigned
+GetNumberOfAvailableCores();
+// SMT siblings of "cpu" (the logical CPUs of its physical core), including "cpu"
+std::vector<int>
+GetCpuSiblings(int cpu);
+// the available CPUs in the order workers are placed on them: one logical CPU
+// of every physical core, then the second SMT thread of every core, etc.
+// With "one_per_core", only one logical CPU of every physical core
+const std::vector<int>&
+GetPlacementOrder(bool one_per_core = false);
 int
 GetThreadId();
 bool
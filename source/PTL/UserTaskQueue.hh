@@ -87,6 +87,9 @@ public:
 
     virtual VUserTaskQueue* clone() override;
 
+    virtual void AcquireClaims() override;
+    virtual void ReleaseClaims() override;
+
     virtual intmax_t GetThreadBin() const override;
 
 protected:
@@ -98,6 +101,7 @@ private:
 
 private:
     bool                       m_is_clone;
+    bool                       m_smt_steal;
     intmax_t                   m_thread_bin;
     mutable intmax_t           m_insert_bin;
     std::atomic_bool*          m_hold;
@@ -69,6 +69,9 @@ public:
 public:
     // execution operator
     virtual void operator()() = 0;
+    // the task will not be executed (e.g. the pool shut down): the future of
+    // the task throws std::future_error (broken_promise)
+    virtual void cancel();
 
 public:
     // used by thread_pool
@@ -31,6 +31,7 @@
 #pragma once
 
 #include "PTL/AutoLock.hh"
+#include "PTL/ThreadData.hh"
 #include "PTL/Threading.hh"
 #include "PTL/VTask.hh"
 
@@ -42,6 +43,7 @@
 #include <deque>
 #include <list>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -112,6 +114,9 @@ public:
     ThreadPool*& pool() { return m_pool; }
     ThreadPool*  pool() const { return m_pool; }
 
+    // the TBB task_group executing the tasks when the pool uses TBB
+    tbb_task_group_t* tbb_task_group() const { return m_tbb_task_group.get(); }
+
     void         clear();
     virtual bool is_native_task_group() const { return true; }
     virtual bool is_master() const { return this_tid() == m_main_tid; }
@@ -142,6 +147,8 @@ protected:
     tid_type        m_main_tid;
     vtask_list_type vtask_list;
     static int      f_verbose;
+
+    std::unique_ptr<tbb_task_group_t> m_tbb_task_group;
 };
 
 inline void
@@ -103,6 +103,11 @@ public:
 
     virtual VUserTaskQueue* clone() = 0;
 
+    // claim all the sub-queues so no thread is in the middle of inserting or
+    // removing a task (e.g. while forking), the default does nothing
+    virtual void AcquireClaims() {}
+    virtual void ReleaseClaims() {}
+
     // operator for number of tasks
     //      prefix versions
     // virtual uintmax_t operator++() = 0;
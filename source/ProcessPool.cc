@@ -0,0 +1,599 @@
+//
+// MIT License
+// Copyright (c) 2019 Jonathan R. Madsen
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software. THE SOFTWARE IS PROVIDED
+// "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT
+// LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+// HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// ---------------------------------------------------------------
+//  Tasking class implementation
+//
+// Class Description:
+//
+// A pool of forked worker processes servicing a shared-memory task queue
+//
+// ---------------------------------------------------------------
+// Author: Jonathan Madsen (Feb 13th 2018)
+// ---------------------------------------------------------------
+
+#include "PTL/ProcessPool.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+#if defined(__linux__)
+#    include <pthread.h>
+#    include <signal.h>
+#    include <sys/mman.h>
+#    include <sys/wait.h>
+#    include <time.h>
+#    include <unistd.h>
+#    define PTL_PROCESS_POOL
+#endif
+
+//======================================================================================//
+
+constexpr ProcessPool::size_type ProcessPool::max_args_size;
+constexpr ProcessPool::size_type ProcessPool::max_groups;
+
+//======================================================================================//
+
+namespace
+{
+std::vector<ProcessPool::function_t>&
+functions()
+{
+    static std::vector<ProcessPool::function_t> _instance;
+    return _instance;
+}
+
+inline size_t
+align_up(size_t _n, size_t _align = 64)
+{
+    return (_n + _align - 1) / _align * _align;
+}
+}  // namespace
+
+//======================================================================================//
+
+int
+ProcessPool::register_function(function_t _func)
+{
+    AutoLock l(TypeMutex<ProcessPool>());
+    functions().push_back(_func);
+    return static_cast<int>(functions().size() - 1);
+}
+
+//======================================================================================//
+
+void
+ProcessPool::check_group(int _group)
+{
+    if(_group < 0 || static_cast<size_type>(_group) >= max_groups)
+        throw std::runtime_error("ProcessPool - invalid task group");
+}
+
+//======================================================================================//
+
+#if defined(PTL_PROCESS_POOL)
+
+namespace
+{
+struct Descriptor
+{
+    int32_t  function;
+    int32_t  group;
+    uint32_t size;
+    alignas(16) char args[ProcessPool::max_args_size];
+};
+
+struct Group
+{
+    int32_t used;
+    int64_t pending;
+    int64_t failed;
+};
+
+struct Worker
+{
+    pid_t      pid;
+    int32_t    busy;
+    Descriptor task;
+};
+}  // namespace
+
+// the header of the shared mapping, followed by the workers and the queue
+struct ProcessPool::Shared
+{
+    pthread_mutex_t mutex;
+    pthread_cond_t  queued;
+    pthread_cond_t  dequeued;
+    pthread_cond_t  completed;
+    int32_t         stop;
+    uint64_t        head;
+    uint64_t        tail;
+    uint64_t        capacity;
+    Group           groups[ProcessPool::max_groups];
+};
+
+//======================================================================================//
+
+namespace
+{
+Worker*
+workers(ProcessPool::Shared* _shared)
+{
+    return reinterpret_cast<Worker*>(reinterpret_cast<char*>(_shared) +
+                                     align_up(sizeof(ProcessPool::Shared)));
+}
+
+Descriptor*
+queue(ProcessPool::Shared* _shared, size_t _nworkers)
+{
+    return reinterpret_cast<Descriptor*>(reinterpret_cast<char*>(workers(_shared)) +
+                                         align_up(_nworkers * sizeof(Worker)));
+}
+
+// the mutex is robust: if a worker died while holding it, the state it
+// protects is still consistent enough for the queue to continue
+void
+lock(ProcessPool::Shared* _shared)
+{
+    if(pthread_mutex_lock(&_shared->mutex) == EOWNERDEAD)
+        pthread_mutex_consistent(&_shared->mutex);
+}
+
+void
+unlock(ProcessPool::Shared* _shared)
+{
+    pthread_mutex_unlock(&_shared->mutex);
+}
+
+void
+wait(ProcessPool::Shared* _shared, pthread_cond_t* _cond)
+{
+    if(pthread_cond_wait(_cond, &_shared->mutex) == EOWNERDEAD)
+        pthread_mutex_consistent(&_shared->mutex);
+}
+
+// called with the lock held
+void
+complete(ProcessPool::Shared* _shared, int32_t _group, bool _failed)
+{
+    Group& _g = _shared->groups[_group];
+    --_g.pending;
+    if(_failed)
+        ++_g.failed;
+    pthread_cond_broadcast(&_shared->completed);
+}
+
+[[noreturn]] void
+execute_worker(ProcessPool::Shared* _shared, Worker* _worker, size_t _nworkers)
+{
+    Descriptor* _queue  = queue(_shared, _nworkers);
+    pid_t       _parent = getppid();
+    for(;;)
+    {
+        lock(_shared);
+        while(!_shared->stop && _shared->head == _shared->tail)
+        {
+            // an idle worker exits if the parent died without stopping the pool
+            timespec _until;
+            clock_gettime(CLOCK_REALTIME, &_until);
+            _until.tv_sec += 1;
+            if(pthread_cond_timedwait(&_shared->queued, &_shared->mutex, &_until) ==
+               EOWNERDEAD)
+                pthread_mutex_consistent(&_shared->mutex);
+            if(getppid() != _parent)
+            {
+                unlock(_shared);
+                _exit(EXIT_FAILURE);
+            }
+        }
+        // the queue is drained before the workers exit
+        if(_shared->head == _shared->tail)
+        {
+            unlock(_shared);
+            _exit(EXIT_SUCCESS);
+        }
+        _worker->task = _queue[_shared->head % _shared->capacity];
+        _worker->busy = 1;
+        ++_shared->head;
+        pthread_cond_signal(&_shared->dequeued);
+        unlock(_shared);
+
+        bool _failed = false;
+        try
+        {
+            functions().at(_worker->task.function)(_worker->task.args);
+        }
+        catch(std::exception& e)
+        {
+            std::cerr << "[PTL::ProcessPool]> task of process " << getpid()
+                      << " threw: " << e.what() << std::endl;
+            _failed = true;
+        }
+
+        lock(_shared);
+        _worker->busy = 0;
+        complete(_shared, _worker->task.group, _failed);
+        unlock(_shared);
+    }
+}
+}  // namespace
+
+//======================================================================================//
+
+ProcessPool::ProcessPool(const size_type& pool_size, size_type arena_size,
+                         bool _use_affinity, const affinity_func_t& _affinity_func)
+: m_pool_size(pool_size)
+, m_use_affinity(_use_affinity)
+, m_affinity_func(_affinity_func)
+, m_arena_len(arena_size)
+{
+    size_type _capacity = GetEnv<size_type>("PTL_PROCESS_QUEUE_SIZE", 1024);
+    if(_capacity == 0)
+        _capacity = 1;
+
+    m_shared_len = align_up(sizeof(Shared)) + align_up(m_pool_size * sizeof(Worker)) +
+                   _capacity * sizeof(Descriptor);
+    void* _mem = mmap(nullptr, m_shared_len, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(_mem == MAP_FAILED)
+        throw std::runtime_error("ProcessPool - mmap of the task queue failed");
+
+    m_shared = new(_mem) Shared;
+    memset(m_shared->groups, 0, sizeof(m_shared->groups));
+    m_shared->stop     = 0;
+    m_shared->head     = 0;
+    m_shared->tail     = 0;
+    m_shared->capacity = _capacity;
+
+    pthread_mutexattr_t _mattr;
+    pthread_mutexattr_init(&_mattr);
+    pthread_mutexattr_setpshared(&_mattr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&_mattr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&m_shared->mutex, &_mattr);
+    pthread_mutexattr_destroy(&_mattr);
+
+    pthread_condattr_t _cattr;
+    pthread_condattr_init(&_cattr);
+    pthread_condattr_setpshared(&_cattr, PTHREAD_PROCESS_SHARED);
+    pthread_cond_init(&m_shared->queued, &_cattr);
+    pthread_cond_init(&m_shared->dequeued, &_cattr);
+    pthread_cond_init(&m_shared->completed, &_cattr);
+    pthread_condattr_destroy(&_cattr);
+
+    Worker* _workers = workers(m_shared);
+    for(size_type i = 0; i < m_pool_size; ++i)
+    {
+        _workers[i].pid  = -1;
+        _workers[i].busy = 0;
+    }
+
+    // mapped before the workers are forked so it has the same address in all of them
+    if(m_arena_len > 0)
+    {
+        _mem = mmap(nullptr, m_arena_len, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if(_mem == MAP_FAILED)
+        {
+            munmap(m_shared, m_shared_len);
+            throw std::runtime_error("ProcessPool - mmap of the shared arena failed");
+        }
+        m_arena = static_cast<char*>(_mem);
+    }
+
+    for(size_type i = 0; i < m_pool_size; ++i)
+        spawn(i);
+
+    m_alive.store(true);
+    m_monitor.reset(new Thread(&ProcessPool::monitor, this));
+}
+
+//======================================================================================//
+
+ProcessPool::~ProcessPool()
+{
+    lock(m_shared);
+    m_shared->stop = 1;
+    pthread_cond_broadcast(&m_shared->queued);
+    unlock(m_shared);
+
+    m_alive.store(false);
+    if(m_monitor)
+        m_monitor->join();
+
+    Worker* _workers = workers(m_shared);
+    for(size_type i = 0; i < m_pool_size; ++i)
+    {
+        if(_workers[i].pid > 0)
+            waitpid(_workers[i].pid, nullptr, 0);
+    }
+
+    pthread_cond_destroy(&m_shared->completed);
+    pthread_cond_destroy(&m_shared->dequeued);
+    pthread_cond_destroy(&m_shared->queued);
+    pthread_mutex_destroy(&m_shared->mutex);
+    munmap(m_shared, m_shared_len);
+    if(m_arena)
+        munmap(m_arena, m_arena_len);
+}
+
+//======================================================================================//
+
+void*
+ProcessPool::allocate(size_type _bytes)
+{
+    AutoLock l(m_mutex);
+    size_type _offset = align_up(m_arena_used);
+    if(!m_arena || _offset + _bytes > m_arena_len)
+        throw std::bad_alloc();
+    m_arena_used = _offset + _bytes;
+    return m_arena + _offset;
+}
+
+//======================================================================================//
+
+int
+ProcessPool::acquire_group()
+{
+    lock(m_shared);
+    for(size_type i = 0; i < max_groups; ++i)
+    {
+        Group& _g = m_shared->groups[i];
+        if(!_g.used)
+        {
+            _g.used    = 1;
+            _g.pending = 0;
+            _g.failed  = 0;
+            unlock(m_shared);
+            return static_cast<int>(i);
+        }
+    }
+    unlock(m_shared);
+    throw std::runtime_error("ProcessPool - more than max_groups task groups");
+}
+
+//======================================================================================//
+
+void
+ProcessPool::release_group(int _group)
+{
+    check_group(_group);
+    lock(m_shared);
+    m_shared->groups[_group].used = 0;
+    unlock(m_shared);
+}
+
+//======================================================================================//
+
+void
+ProcessPool::submit(int _group, int _function, const void* _args, size_type _size)
+{
+    if(_function < 0 || _function >= static_cast<int>(functions().size()))
+        throw std::runtime_error("ProcessPool - task function is not registered");
+    if(_size > max_args_size)
+        throw std::runtime_error("ProcessPool - task argument exceeds max_args_size");
+    check_group(_group);
+
+    Descriptor* _queue = queue(m_shared, m_pool_size);
+    lock(m_shared);
+    while(m_shared->tail - m_shared->head >= m_shared->capacity)
+        wait(m_shared, &m_shared->dequeued);
+
+    Descriptor& _task = _queue[m_shared->tail % m_shared->capacity];
+    _task.function    = _function;
+    _task.group       = _group;
+    _task.size        = static_cast<uint32_t>(_size);
+    if(_size > 0)
+        memcpy(_task.args, _args, _size);
+    ++m_shared->tail;
+    ++m_shared->groups[_group].pending;
+    pthread_cond_signal(&m_shared->queued);
+    unlock(m_shared);
+}
+
+//======================================================================================//
+
+ProcessPool::size_type
+ProcessPool::join(int _group)
+{
+    check_group(_group);
+    lock(m_shared);
+    Group& _g = m_shared->groups[_group];
+    while(_g.pending > 0)
+        wait(m_shared, &m_shared->completed);
+    size_type _failed = _g.failed;
+    _g.failed         = 0;
+    unlock(m_shared);
+    return _failed;
+}
+
+//======================================================================================//
+
+bool
+ProcessPool::spawn(size_type i)
+{
+    Worker* _worker = workers(m_shared) + i;
+    pid_t   _pid    = fork();
+    if(_pid < 0)
+    {
+        std::cerr << "[PTL::ProcessPool]> fork failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    if(_pid == 0)
+    {
+        if(m_use_affinity)
+        {
+            NativeThread _self = pthread_self();
+            Threading::SetPinAffinity(m_affinity_func(i), _self);
+        }
+        execute_worker(m_shared, _worker, m_pool_size);
+    }
+
+    _worker->pid = _pid;
+    return true;
+}
+
+//======================================================================================//
+
+void
+ProcessPool::monitor()
+{
+    typedef std::chrono::steady_clock clock_type;
+
+    Worker*                   _workers = workers(m_shared);
+    clock_type::time_point    _retry   = clock_type::now();
+    std::chrono::milliseconds _backoff(10);
+    while(m_alive.load())
+    {
+        // slots without a worker (the fork failed) are retried with a back-off
+        if(clock_type::now() >= _retry)
+        {
+            bool _failed = false;
+            for(size_type i = 0; i < m_pool_size; ++i)
+            {
+                if(_workers[i].pid <= 0 && !m_shared->stop && !spawn(i))
+                    _failed = true;
+            }
+            _backoff = (_failed) ? std::min(2 * _backoff, std::chrono::milliseconds(1000))
+                                 : std::chrono::milliseconds(10);
+            _retry   = clock_type::now() + _backoff;
+        }
+
+        // without any worker the queued tasks would never be executed, they fail so
+        // that join() returns
+        size_type _nalive = 0;
+        for(size_type i = 0; i < m_pool_size; ++i)
+            _nalive += (_workers[i].pid > 0) ? 1 : 0;
+        if(_nalive == 0)
+        {
+            Descriptor* _queue = queue(m_shared, m_pool_size);
+            lock(m_shared);
+            if(m_shared->head != m_shared->tail)
+            {
+                std::cerr << "[PTL::ProcessPool]> no worker process, "
+                          << (m_shared->tail - m_shared->head) << " queued tasks failed"
+                          << std::endl;
+                for(; m_shared->head != m_shared->tail; ++m_shared->head)
+                    complete(m_shared, _queue[m_shared->head % m_shared->capacity].group,
+                             true);
+                pthread_cond_broadcast(&m_shared->dequeued);
+            }
+            unlock(m_shared);
+        }
+
+        for(size_type i = 0; i < m_pool_size; ++i)
+        {
+            Worker& _worker = _workers[i];
+            int     _status = 0;
+            if(_worker.pid <= 0 || waitpid(_worker.pid, &_status, WNOHANG) != _worker.pid)
+                continue;
+
+            // the task the worker was executing failed
+            lock(m_shared);
+            bool _stop = m_shared->stop;
+            if(!_stop)
+                ++m_restarts;
+            if(_worker.busy)
+            {
+                _worker.busy = 0;
+                complete(m_shared, _worker.task.group, true);
+            }
+            unlock(m_shared);
+
+            _worker.pid = -1;
+            if(_stop)
+                continue;
+
+            if(WIFSIGNALED(_status))
+                std::cerr << "[PTL::ProcessPool]> worker " << i << " was killed by "
+                          << strsignal(WTERMSIG(_status)) << ", restarting..."
+                          << std::endl;
+            else
+                std::cerr << "[PTL::ProcessPool]> worker " << i << " exited with "
+                          << WEXITSTATUS(_status) << ", restarting..." << std::endl;
+
+            if(!spawn(i))
+                _retry = clock_type::now();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+//======================================================================================//
+
+#else
+
+struct ProcessPool::Shared
+{};
+
+ProcessPool::ProcessPool(const size_type& pool_size, size_type arena_size,
+                         bool _use_affinity, const affinity_func_t& _affinity_func)
+: m_pool_size(pool_size)
+, m_use_affinity(_use_affinity)
+, m_affinity_func(_affinity_func)
+, m_arena_len(arena_size)
+{
+    throw std::runtime_error("ProcessPool - not available on this platform");
+}
+
+ProcessPool::~ProcessPool() {}
+
+void*
+ProcessPool::allocate(size_type)
+{
+    throw std::bad_alloc();
+}
+
+int
+ProcessPool::acquire_group()
+{
+    return 0;
+}
+
+void
+ProcessPool::release_group(int)
+{}
+
+void
+ProcessPool::submit(int, int, const void*, size_type)
+{}
+
+ProcessPool::size_type
+ProcessPool::join(int)
+{
+    return 0;
+}
+
+bool
+ProcessPool::spawn(size_type)
+{
+    return false;
+}
+
+void
+ProcessPool::monitor()
+{}
+
+#endif
+
+//======================================================================================//
@@ -64,7 +64,7 @@ TaskRunManager::GetInstance(bool useTBB)
 TaskRunManager::TaskRunManager(bool useTBB)
 : isInitialized(false)
 , verbose(0)
-, nworkers(std::thread::hardware_concurrency())
+, nworkers(Threading::GetNumberOfAvailableCores())
 , taskQueue(nullptr)
 , threadPool(nullptr)
 , taskManager(nullptr)
@@ -42,9 +42,11 @@ ThreadData::ThreadData()
 : is_master(false)
 , within_task(false)
 , task_depth(0)
+, thread_index(-1)
 , thread_pool(nullptr)
 , current_queue(nullptr)
 , queue_stack()
+, pool_stack()
 {
 }
 
@@ -54,9 +56,11 @@ ThreadData::ThreadData(ThreadPool* tp)
 : is_master(tp->is_master())
 , within_task(false)
 , task_depth(0)
+, thread_index(tp->get_thread_index())
 , thread_pool(tp)
 , current_queue(tp->get_queue())
 , queue_stack({ current_queue })
+, pool_stack()
 {
 }
 
@@ -65,18 +69,42 @@ ThreadData::ThreadData(ThreadPool* tp)
 ThreadData&
 ThreadData::operator=(ThreadPool* tp)
 {
-    if(tp)
-    {
-        is_master     = tp->is_master();
-        thread_pool   = tp;
-        current_queue = tp->get_queue();
-        queue_stack.push_back(current_queue);
-    }
+    push(tp);
     return *this;
 }
 
 //======================================================================================//
 
+void
+ThreadData::push(ThreadPool* tp)
+{
+    if(!tp)
+        return;
+    pool_stack.push_back({ thread_pool, is_master, thread_index });
+    is_master     = tp->is_master();
+    thread_index  = tp->get_thread_index();
+    thread_pool   = tp;
+    current_queue = tp->get_queue();
+    queue_stack.push_back(current_queue);
+}
+
+//======================================================================================//
+
+void
+ThreadData::pop()
+{
+    if(pool_stack.empty())
+        return;
+    is_master    = pool_stack.back().is_master;
+    thread_index = pool_stack.back().thread_index;
+    thread_pool  = pool_stack.back().pool;
+    pool_stack.pop_back();
+    queue_stack.pop_back();
+    current_queue = (queue_stack.empty()) ? nullptr : queue_stack.back();
+}
+
+//======================================================================================//
+
 ThreadData::~ThreadData() {}
 
 //======================================================================================//
@@ -34,7 +34,15 @@
 #include "PTL/UserTaskQueue.hh"
 #include "PTL/VUserTaskQueue.hh"
 
+#include <algorithm>
 #include <cstdlib>
+#include <mutex>
+#include <set>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(WIN64) && !defined(_WIN64)
+#    include <pthread.h>
+#    define PTL_FORK_HANDLERS
+#endif
 
 #if defined(PTL_USE_GPERF)
 #    include <gperftools/heap-checker.h>
@@ -52,7 +60,9 @@ ncores()
 
 //======================================================================================//
 
-ThreadPool::thread_id_map_t ThreadPool::f_thread_ids;
+ThreadPool::thread_id_map_t  ThreadPool::f_thread_ids;
+ThreadPool::thread_cpu_map_t ThreadPool::f_thread_cpus;
+ThreadPool::atomic_int_type  ThreadPool::f_thread_generation(0);
 
 //======================================================================================//
 
@@ -63,6 +73,39 @@ thread_data()
 {
     return ThreadData::GetInstance();
 }
+
+// the pools with workers, these are quiesced before a fork
+std::set<ThreadPool*>&
+live_pools()
+{
+    static auto* _instance = new std::set<ThreadPool*>();
+    return *_instance;
+}
+
+// the stolen tasks executing on this thread, innermost first (a stolen task may
+// execute other stolen tasks while it waits in a join)
+struct stolen_frame
+{
+    const ThreadPool* pool;
+    stolen_frame*     prev;
+};
+
+stolen_frame*&
+stolen_frames()
+{
+    ThreadLocalStatic stolen_frame* _instance = nullptr;
+    return _instance;
+}
+
+// number of the stolen tasks of "_pool" executing on this thread
+intmax_t
+stolen_on_this_thread(const ThreadPool* _pool)
+{
+    intmax_t _n = 0;
+    for(auto* itr = stolen_frames(); itr; itr = itr->prev)
+        _n += (itr->pool == _pool) ? 1 : 0;
+    return _n;
+}
 }
 
 //======================================================================================//
@@ -73,7 +116,7 @@ bool ThreadPool::f_use_tbb = false;
 // static member function that calls the member function we want the thread to
 // run
 void
-ThreadPool::start_thread(ThreadPool* tp, intmax_t _idx)
+ThreadPool::start_thread(ThreadPool* tp, intmax_t _idx, intmax_t _worker)
 {
     {
         AutoLock lock(TypeMutex<ThreadPool>(), std::defer_lock);
@@ -82,7 +125,20 @@ ThreadPool::start_thread(ThreadPool* tp, intmax_t _idx)
         if(_idx < 0)
             _idx = f_thread_ids.size();
         f_thread_ids[std::this_thread::get_id()] = _idx;
+        if(_worker >= 0)
+            tp->m_thread_ids[std::this_thread::get_id()] = _worker + 1;
+        ++f_thread_generation;
     }
+    // the worker sets its own affinity
+    if(_worker >= 0 && tp->m_use_affinity)
+    {
+#if defined(__linux__) || defined(_AIX)
+        tp->pin_thread(_worker, pthread_self(), ThisThread::get_id());
+#endif
+    }
+    // the workers started in parallel create the next workers
+    if(_worker >= 0 && tp->m_start_count.load() > 0)
+        tp->start_children(_worker - static_cast<intmax_t>(tp->m_start_first.load()));
     thread_data().reset(new ThreadData(tp));
     tp->execute_thread(thread_data()->current_queue);
 }
@@ -113,6 +169,7 @@ ThreadPool::GetThisThreadID()
         {
             auto _idx          = f_thread_ids.size();
             f_thread_ids[_tid] = _idx;
+            ++f_thread_generation;
         }
     }
     return f_thread_ids[_tid];
@@ -120,10 +177,51 @@ ThreadPool::GetThisThreadID()
 
 //======================================================================================//
 
+const std::vector<uintmax_t>&
+ThreadPool::get_sibling_thread_indices() const
+{
+    // recomputed when a thread is added or pinned, or for another pool
+    ThreadLocalStatic std::vector<uintmax_t>* _ids        = nullptr;
+    ThreadLocalStatic uintmax_t               _generation = 0;
+    ThreadLocalStatic const ThreadPool*       _pool       = nullptr;
+    if(!_ids)
+        _ids = new std::vector<uintmax_t>();
+
+    if(_pool != this || _generation != f_thread_generation.load())
+    {
+        AutoLock lock(TypeMutex<ThreadPool>());
+        _pool       = this;
+        _generation = f_thread_generation.load();
+        _ids->clear();
+        auto itr = f_thread_cpus.find(ThisThread::get_id());
+        if(itr == f_thread_cpus.end() || m_thread_ids.count(itr->first) == 0)
+            return *_ids;
+
+        // only the threads of this pool, by their index in this pool
+        auto _siblings = Threading::GetCpuSiblings(itr->second);
+        for(const auto& titr : f_thread_cpus)
+        {
+            if(titr.first == itr->first ||
+               std::find(_siblings.begin(), _siblings.end(), titr.second) ==
+                   _siblings.end())
+                continue;
+            auto iitr = m_thread_ids.find(titr.first);
+            if(iitr != m_thread_ids.end())
+                _ids->push_back(iitr->second);
+        }
+    }
+    return *_ids;
+}
+
+//======================================================================================//
+
 ThreadPool::ThreadPool(const size_type& pool_size, VUserTaskQueue* task_queue,
                        bool _use_affinity, const affinity_func_t& _affinity_func)
 : m_use_affinity(_use_affinity)
 , m_tbb_tp(false)
+, m_start_mode(thread_pool::start::EAGER)
+, m_shutdown(thread_pool::shutdown::IMMEDIATE)
+, m_shutdown_timeout(10.0)
 , m_alive_flag(false)
 , m_verbose(0)
 , m_pool_size(0)
@@ -132,11 +230,34 @@ ThreadPool::ThreadPool(const size_type& pool_size, VUserTaskQueue* task_queue,
 , m_thread_awake(new atomic_int_type(0))
 , m_task_queue(task_queue)
 , m_tbb_task_group(nullptr)
+, m_tbb_task_arena(nullptr)
 , m_init_func([]() { return; })
 , m_affinity_func(_affinity_func)
 {
     m_verbose = GetEnv<int>("PTL_VERBOSE", m_verbose);
 
+    static EnvChoiceList<int> _start_choices = {
+        EnvChoice<int>(thread_pool::start::EAGER, "EAGER", "create the threads in turn"),
+        EnvChoice<int>(thread_pool::start::LAZY, "LAZY", "create threads on demand"),
+        EnvChoice<int>(thread_pool::start::PARALLEL, "PARALLEL",
+                       "threads create the other threads")
+    };
+    m_start_mode   = GetEnv<int>("PTL_POOL_START", _start_choices, m_start_mode);
+    m_start_fanout = std::max<size_type>(
+        GetEnv<size_type>("PTL_POOL_START_FANOUT", m_start_fanout), 2);
+
+    static EnvChoiceList<int> _shutdown_choices = {
+        EnvChoice<int>(thread_pool::shutdown::IMMEDIATE, "IMMEDIATE",
+                       "stop once the workers find the queue empty"),
+        EnvChoice<int>(thread_pool::shutdown::DRAIN, "DRAIN", "execute the queued tasks"),
+        EnvChoice<int>(thread_pool::shutdown::CANCEL, "CANCEL",
+                       "cancel the queued tasks"),
+        EnvChoice<int>(thread_pool::shutdown::BOUNDED, "BOUNDED",
+                       "drain for PTL_SHUTDOWN_TIMEOUT seconds, then cancel")
+    };
+    m_shutdown         = GetEnv<int>("PTL_SHUTDOWN", _shutdown_choices, m_shutdown);
+    m_shutdown_timeout = GetEnv<double>("PTL_SHUTDOWN_TIMEOUT", m_shutdown_timeout);
+
     if(!m_task_queue)
         m_task_queue = new UserTaskQueue(pool_size);
 
@@ -144,7 +265,16 @@ ThreadPool::ThreadPool(const size_type& pool_size, VUserTaskQueue* task_queue,
     if(master_id != 0 && m_verbose > 1)
         std::cerr << "ThreadPool created on non-master slave" << std::endl;
 
-    thread_data().reset(new ThreadData(this));
+    {
+        AutoLock lock(TypeMutex<ThreadPool>());
+        m_thread_ids[m_master_tid] = 0;
+    }
+
+    // a thread already using another pool can return to it (see ThreadData::pop)
+    if(thread_data())
+        thread_data()->push(this);
+    else
+        thread_data().reset(new ThreadData(this));
 
     // initialize after GetThisThreadID so master is zero
     this->initialize_threadpool(pool_size);
@@ -154,8 +284,199 @@ ThreadPool::ThreadPool(const size_type& pool_size, VUserTaskQueue* task_queue,
 
 ThreadPool::~ThreadPool()
 {
+    // a pool cannot be destroyed by one of its own tasks: a task stolen by the
+    // worker of another pool would return into the destroyed pool
+    if(stolen_on_this_thread(this) > 0)
+    {
+        std::cerr << "ThreadPool::~ThreadPool - the pool is destroyed by one of its "
+                  << "tasks executing on a worker of another pool" << std::endl;
+        abort();
+    }
+    {
+        AutoLock lock(TypeMutex<std::set<ThreadPool*>>());
+        live_pools().erase(this);
+    }
+    leave_federation();
     if(m_alive_flag.load())
         destroy_threadpool();
+    delete m_event_sources.exchange(nullptr);
+
+    if(thread_data() && thread_data()->thread_pool == this)
+        thread_data()->pop();
+
+    ThreadPool* _blocking = m_blocking_pool.exchange(nullptr);
+    if(_blocking)
+    {
+        task_queue_t* _queue = _blocking->m_task_queue;
+        delete _blocking;
+        delete _queue;
+    }
+}
+
+//======================================================================================//
+
+intmax_t
+ThreadPool::get_thread_index(ThreadId _tid) const
+{
+    AutoLock lock(TypeMutex<ThreadPool>());
+    auto     itr = m_thread_ids.find(_tid);
+    return (itr == m_thread_ids.end()) ? -1 : static_cast<intmax_t>(itr->second);
+}
+
+//======================================================================================//
+
+ThreadPool::size_type
+ThreadPool::idle_threads() const
+{
+    size_type _awake = (m_thread_awake) ? m_thread_awake->load() : 0;
+    return m_pool_size - std::min<size_type>(_awake, m_pool_size);
+}
+
+//======================================================================================//
+
+void
+ThreadPool::federate(bool _stealable)
+{
+    // TBB schedules its own workers, the blocking workers should not take
+    // compute tasks
+    if(m_tbb_tp || m_parent)
+        return;
+    m_stealable.store(_stealable);
+    m_federated.store(true);
+    Federation::instance().add(this);
+}
+
+//======================================================================================//
+
+void
+ThreadPool::leave_federation()
+{
+    if(!m_federated.exchange(false))
+        return;
+    Federation::instance().remove(this);
+    // the tasks taken by the workers of the other pools hold on to this pool. The
+    // stolen tasks of this pool executing on this thread (the caller is one of
+    // them) cannot finish while it waits, so they are not waited for
+    intmax_t _own = stolen_on_this_thread(this);
+    while(m_stolen.load() > _own)
+        ThisThread::sleep_for(std::chrono::milliseconds(1));
+}
+
+//======================================================================================//
+
+ThreadPool::task_pointer
+ThreadPool::steal_task()
+{
+    // Federation::mutex() is held so the pool cannot leave the federation
+    // before m_stolen is incremented
+    task_pointer _task = m_task_queue->GetTask();
+    if(_task)
+    {
+        ++m_stolen;
+        ++m_executing;
+    }
+    return _task;
+}
+
+//======================================================================================//
+
+void
+ThreadPool::execute_stolen(task_pointer _task)
+{
+    auto& _data   = thread_data();
+    bool  _within = _data->within_task;
+    _data->push(this);
+    _data->within_task = true;
+
+    stolen_frame _frame = { this, stolen_frames() };
+    stolen_frames()     = &_frame;
+
+    bool _owned = (_task->group() == nullptr);
+    (*_task)();
+    if(_owned)
+        delete _task;
+
+    stolen_frames() = _frame.prev;
+
+    _data->within_task = _within;
+    _data->pop();
+    --m_executing;
+    --m_stolen;
+}
+
+//======================================================================================//
+
+void
+ThreadPool::wake_thief()
+{
+    m_steal_wake.store(true);
+    AutoLock l(m_task_lock);
+    m_task_cond.notify_one();
+}
+
+//======================================================================================//
+
+void
+ThreadPool::start_event_poller()
+{
+    // the idle workers may all be waiting on the condition
+    m_poll_wake.store(true);
+    AutoLock l(m_task_lock);
+    m_task_cond.notify_one();
+}
+
+//======================================================================================//
+
+EventSources*
+ThreadPool::event_sources()
+{
+    EventSources* _events = m_event_sources.load();
+    if(!_events)
+    {
+        AutoLock lock(TypeMutex<EventSources>());
+        _events = m_event_sources.load();
+        if(!_events)
+        {
+            _events = new EventSources(this);
+            m_event_sources.store(_events);
+        }
+    }
+    return _events;
+}
+
+//======================================================================================//
+
+ThreadPool*
+ThreadPool::blocking_pool()
+{
+    if(m_parent)
+        return this;
+
+    ThreadPool* _blocking = m_blocking_pool.load();
+    if(!_blocking)
+    {
+        AutoLock lock(m_start_lock);
+        _blocking = m_blocking_pool.load();
+        if(!_blocking)
+        {
+            size_type _size = std::max<size_type>(
+                GetEnv<size_type>("PTL_BLOCKING_THREADS", 2 * size()), 1);
+            // the constructor makes the new pool the pool of this thread
+            auto _data = std::move(thread_data());
+            _blocking  = new ThreadPool(0, new UserTaskQueue(_size), false);
+            thread_data() = std::move(_data);
+            // the blocking workers do not occupy a core while they wait and are
+            // only created when needed
+            _blocking->m_parent           = this;
+            _blocking->m_start_mode       = thread_pool::start::LAZY;
+            _blocking->m_shutdown         = m_shutdown;
+            _blocking->m_shutdown_timeout = m_shutdown_timeout;
+            _blocking->m_verbose          = m_verbose;
+            _blocking->initialize_threadpool(_size);
+            m_blocking_pool.store(_blocking);
+        }
+    }
+    return _blocking;
 }
 
 //======================================================================================//
@@ -170,17 +491,29 @@ ThreadPool::is_initialized() const
 
 void
 ThreadPool::set_affinity(intmax_t i, Thread& _thread)
+{
+    pin_thread(i, _thread.native_handle(), _thread.get_id());
+}
+
+//======================================================================================//
+
+void
+ThreadPool::pin_thread(intmax_t i, NativeThread native_thread, ThreadId _tid)
 {
     try
     {
-        NativeThread native_thread = _thread.native_handle();
-        intmax_t     _pin          = m_affinity_func(i);
+        intmax_t _pin = m_affinity_func(i);
         if(m_verbose > 0)
         {
-            std::cout << "Setting pin affinity for thread " << _thread.get_id() << " to "
-                      << _pin << std::endl;
+            std::cout << "Setting pin affinity for thread " << _tid << " to " << _pin
+                      << std::endl;
+        }
+        if(Threading::SetPinAffinity(_pin, native_thread))
+        {
+            AutoLock lock(TypeMutex<ThreadPool>());
+            f_thread_cpus[_tid] = _pin;
+            ++f_thread_generation;
         }
-        Threading::SetPinAffinity(_pin, native_thread);
     }
     catch(std::runtime_error& e)
     {
@@ -209,26 +542,45 @@ ThreadPool::initialize_threadpool(size_type proposed_size)
 #ifdef PTL_USE_TBB
     if(f_use_tbb)
     {
-        m_tbb_tp                               = true;
-        m_pool_size                            = proposed_size;
-        tbb_task_scheduler_t*& _task_scheduler = tbb_task_scheduler();
-        // delete if wrong size
-        if(m_pool_size != proposed_size)
+        m_tbb_tp    = true;
+        m_pool_size = proposed_size;
+        int _nconc  = static_cast<int>(proposed_size + 1);
         {
-            delete _task_scheduler;
-            _task_scheduler = nullptr;
+            // the global limit is shared by every pool (and the other users of TBB
+            // in the process) so it is only ever raised: a control is only created
+            // when the active limit (the hardware concurrency without any control)
+            // is lower than this pool needs
+            AutoLock _lk(TypeMutex<tbb_global_control_t>());
+            tbb_global_control_t*& _control = tbb_global_control();
+            auto _param = tbb_global_control_t::max_allowed_parallelism;
+            if(tbb_global_control_t::active_value(_param) < static_cast<size_t>(_nconc))
+            {
+                delete _control;
+                _control = new tbb_global_control_t(_param, _nconc);
+            }
         }
-
-        if(!_task_scheduler)
+        // re-create the arena if the concurrency changed
+        if(m_tbb_task_arena && m_tbb_task_arena->max_concurrency() != _nconc)
         {
-            _task_scheduler =
-                new tbb_task_scheduler_t(tbb::task_scheduler_init::deferred);
+            if(m_tbb_task_group)
+                m_tbb_task_arena->execute([&]() { m_tbb_task_group->wait(); });
+            delete m_tbb_task_arena;
+            m_tbb_task_arena = nullptr;
         }
-
-        if(!_task_scheduler->is_active())
+        // each pool gets its own arena so that work submitted to one pool
+        // never executes on the threads reserved for another
+        if(!m_tbb_task_arena)
         {
-            m_pool_size = proposed_size;
-            _task_scheduler->initialize(proposed_size + 1);
+#    if TBB_INTERFACE_VERSION >= 12010
+            tbb::task_arena::constraints _constraints;
+            _constraints.numa_id =
+                GetEnv<int>("PTL_TBB_NUMA_NODE", tbb::task_arena::automatic);
+            _constraints.max_concurrency = _nconc;
+            m_tbb_task_arena             = new tbb_task_arena_t(_constraints);
+#    else
+            m_tbb_task_arena = new tbb_task_arena_t(_nconc);
+#    endif
+            m_tbb_task_arena->initialize();
             if(m_verbose > 0)
             {
                 std::cout << "ThreadPool [TBB] initialized with " << m_pool_size
@@ -242,32 +594,47 @@ ThreadPool::initialize_threadpool(size_type proposed_size)
     }
 
     // NOLINT(readability-else-after-return)
-    if(f_use_tbb && tbb_task_scheduler())
+    if(m_tbb_tp)
     {
-        m_tbb_tp                               = false;
-        tbb_task_scheduler_t*& _task_scheduler = tbb_task_scheduler();
-        if(_task_scheduler)
-        {
-            _task_scheduler->terminate();
-            delete _task_scheduler;
-            _task_scheduler = nullptr;
-        }
-        // delete task group (used for async)
+        // switching back from TBB: release the arena and task group
+        m_tbb_tp = false;
         if(m_tbb_task_group)
         {
-            m_tbb_task_group->wait();
+            m_tbb_task_arena->execute([&]() { m_tbb_task_group->wait(); });
             delete m_tbb_task_group;
             m_tbb_task_group = nullptr;
         }
+        delete m_tbb_task_arena;
+        m_tbb_task_arena = nullptr;
     }
 #endif
 
+    // quiesce the pool before a fork and re-create the workers in the child
+    // (the blocking workers are handled by the pool they belong to)
+    if(!m_parent)
+    {
+#if defined(PTL_FORK_HANDLERS)
+        static std::once_flag _once;
+        std::call_once(_once, []() {
+            pthread_atfork(&ThreadPool::fork_prepare, &ThreadPool::fork_parent,
+                           &ThreadPool::fork_child);
+        });
+#endif
+        {
+            AutoLock lock(TypeMutex<std::set<ThreadPool*>>());
+            live_pools().insert(this);
+        }
+        if(!m_federated.load() && GetEnv<bool>("PTL_FEDERATE", false))
+            federate(true);
+    }
+
     m_alive_flag.store(true);
 
     //--------------------------------------------------------------------//
     // if started, stop some thread if smaller or return if equal
     if(m_pool_state.load() == thread_pool::state::STARTED)
     {
+        m_target_size.store(proposed_size);
         if(m_pool_size > proposed_size)
         {
             while(stop_thread() > proposed_size)
@@ -297,37 +664,40 @@ ThreadPool::initialize_threadpool(size_type proposed_size)
         m_is_joined.reserve(proposed_size);
     }
 
-    auto this_tid = GetThisThreadID();
-    for(size_type i = m_pool_size; i < proposed_size; ++i)
+    // the blocking workers are numbered after the workers of the pool they belong to
+    m_start_index = (m_parent) ? (m_parent->m_start_index + m_parent->size())
+                               : GetThisThreadID();
+    if(m_start_mode == thread_pool::start::LAZY)
     {
-        // add the threads
-        try
-        {
-            using pointer_t = std::unique_ptr<Thread>;
-            auto tid =
-                pointer_t(new Thread(ThreadPool::start_thread, this, this_tid + i + 1));
-            // only reaches here if successful creation of thread
-            ++m_pool_size;
-            // store thread
-            m_main_threads.push_back(tid->get_id());
-            // list of joined thread booleans
-            m_is_joined.push_back(false);
-            // set the affinity
-            if(m_use_affinity)
-                set_affinity(i, *tid.get());
-            // detach
-            m_unique_threads.emplace_back(std::move(tid));
-        }
-        catch(std::runtime_error& e)
-        {
-            std::cerr << e.what() << std::endl;  // issue creating thread
-            continue;
-        }
-        catch(std::bad_alloc& e)
-        {
-            std::cerr << e.what() << std::endl;
-            continue;
-        }
+        // start one thread, the others are created as the tasks queue up
+        AutoLock lock(m_start_lock);
+        m_target_size.store(proposed_size);
+        if(m_pool_size == 0)
+            create_thread(0);
+    }
+    else if(m_start_mode == thread_pool::start::PARALLEL)
+    {
+        // create the first threads, each of them creates the next ones
+        AutoLock lock(m_start_lock);
+        size_type _count = proposed_size - m_pool_size;
+        m_start_done     = 0;
+        m_start_first.store(m_pool_size);
+        m_start_count.store(_count);
+        lock.unlock();
+
+        start_children(-1);
+
+        lock.lock();
+        m_start_cond.wait(lock, [&]() { return m_start_done >= _count; });
+        m_start_count.store(0);
+        m_target_size.store(m_pool_size);
+    }
+    else
+    {
+        AutoLock lock(m_start_lock);
+        for(size_type i = m_pool_size; i < proposed_size; ++i)
+            create_thread(i);
+        m_target_size.store(m_pool_size);
     }
     //------------------------------------------------------------------------//
 
@@ -355,20 +725,304 @@ ThreadPool::initialize_threadpool(size_type proposed_size)
 
 //======================================================================================//
 
+bool
+ThreadPool::create_thread(size_type i)
+{
+    // m_start_lock is held by the caller
+    return register_thread(spawn_thread(i));
+}
+
+//======================================================================================//
+
+std::unique_ptr<Thread>
+ThreadPool::spawn_thread(size_type i)
+{
+    // no lock is needed, the index of the worker is given to the thread
+    try
+    {
+        return std::unique_ptr<Thread>(
+            new Thread(ThreadPool::start_thread, this, m_start_index + i + 1, i));
+    }
+    catch(std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;  // issue creating thread
+    }
+    catch(std::bad_alloc& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+    return std::unique_ptr<Thread>();
+}
+
+//======================================================================================//
+
+bool
+ThreadPool::register_thread(std::unique_ptr<Thread>&& tid)
+{
+    // m_start_lock is held by the caller
+    bool _created = static_cast<bool>(tid);
+    if(_created)
+    {
+        AutoLock _task_lock(m_task_lock);
+        ++m_pool_size;
+        // store thread
+        m_main_threads.push_back(tid->get_id());
+        // list of joined thread booleans
+        m_is_joined.push_back(false);
+        m_unique_threads.emplace_back(std::move(tid));
+    }
+    ++m_start_done;
+    m_start_cond.notify_all();
+    return _created;
+}
+
+//======================================================================================//
+
+void
+ThreadPool::start_children(intmax_t r)
+{
+    // the threads started in parallel form a tree: thread "r" creates threads
+    // fanout * (r + 1) + [0, fanout), the creating thread is r = -1. The
+    // children of a thread that could not be created are created by its parent
+    size_type _first = m_start_first.load();
+    size_type _count = m_start_count.load();
+    for(size_type k = 0; k < m_start_fanout; ++k)
+    {
+        size_type c = m_start_fanout * static_cast<size_type>(r + 1) + k;
+        if(c >= _count)
+            break;
+        // the thread is created without the lock so the threads of the tree create
+        // their children concurrently, the lock is only taken to register it
+        auto _thread  = spawn_thread(_first + c);
+        bool _created = false;
+        {
+            AutoLock lock(m_start_lock);
+            _created = register_thread(std::move(_thread));
+        }
+        if(!_created)
+            start_children(static_cast<intmax_t>(c));
+    }
+}
+
+//======================================================================================//
+
+void
+ThreadPool::grow()
+{
+    // create a thread when more tasks are queued than there are sleeping threads
+    size_type _awake = (m_thread_awake) ? m_thread_awake->load() : 0;
+    size_type _idle  = m_pool_size - std::min<size_type>(_awake, m_pool_size);
+    if(m_task_queue->true_size() <= _idle)
+        return;
+
+    // another thread is creating one
+    AutoLock lock(m_start_lock, std::try_to_lock);
+    if(!lock.owns_lock())
+        return;
+
+    if(m_pool_state.load() != thread_pool::state::STARTED ||
+       m_pool_size >= m_target_size.load())
+        return;
+
+    // after a fork, all the workers are re-created (unless LAZY)
+    if(m_respawn.exchange(false) && m_start_mode != thread_pool::start::LAZY)
+    {
+        for(size_type i = m_pool_size; i < m_target_size.load(); ++i)
+            create_thread(i);
+        return;
+    }
+
+    create_thread(m_pool_size);
+}
+
+//======================================================================================//
+
+void
+ThreadPool::fork_prepare()
+{
+    TypeMutex<std::set<ThreadPool*>>().lock();
+    Federation::instance().mutex().lock();
+    for(auto& itr : live_pools())
+        itr->prepare_fork();
+    TypeMutex<ThreadPool>().lock();
+}
+
+//======================================================================================//
+
+void
+ThreadPool::fork_parent()
+{
+    TypeMutex<ThreadPool>().unlock();
+    for(auto& itr : live_pools())
+        itr->resume_after_fork(false);
+    Federation::instance().mutex().unlock();
+    TypeMutex<std::set<ThreadPool*>>().unlock();
+}
+
+//======================================================================================//
+
+void
+ThreadPool::fork_child()
+{
+    TypeMutex<ThreadPool>().unlock();
+    for(auto& itr : live_pools())
+        itr->resume_after_fork(true);
+    new(&Federation::instance().mutex()) Mutex();
+    TypeMutex<std::set<ThreadPool*>>().unlock();
+}
+
+//======================================================================================//
+
+void
+ThreadPool::prepare_fork()
+{
+    // TBB handles the fork of its own workers
+    m_forking = (m_alive_flag.load() && !m_tbb_tp);
+    if(!m_forking)
+        return;
+
+    // no worker is being created, going to sleep or picking a task
+    m_start_lock.lock();
+    m_task_lock.lock();
+    m_task_queue->AcquireClaims();
+
+    ThreadPool* _blocking = m_blocking_pool.load();
+    if(_blocking)
+        _blocking->prepare_fork();
+}
+
+//======================================================================================//
+
+void
+ThreadPool::resume_after_fork(bool _child)
+{
+    if(!m_forking)
+        return;
+    m_forking = false;
+
+    ThreadPool* _blocking = m_blocking_pool.load();
+    if(_blocking)
+        _blocking->resume_after_fork(_child);
+
+    m_task_queue->ReleaseClaims();
+    if(!_child)
+    {
+        m_task_lock.unlock();
+        m_start_lock.unlock();
+        return;
+    }
+
+    // the workers (and the threads waiting on the locks and conditions) only
+    // exist in the parent: the thread objects are abandoned, the queued tasks
+    // are kept and the workers are re-created when a task is added. The tasks
+    // that were executing in the parent are lost
+    new(&m_task_lock) lock_t();
+    new(&m_start_lock) lock_t();
+    new(&m_task_cond) condition_t();
+    new(&m_start_cond) condition_t();
+
+    for(auto _tid : m_main_threads)
+    {
+        f_thread_ids.erase(_tid);
+        f_thread_cpus.erase(_tid);
+        m_thread_ids.erase(_tid);
+    }
+    ++f_thread_generation;
+
+    for(auto& itr : m_unique_threads)
+        itr.release();
+
+    m_target_size.store(std::max<size_type>(m_pool_size, m_target_size.load()));
+    m_pool_size = 0;
+    m_start_count.store(0);
+    m_start_done = 0;
+    m_executing.store(0);
+    m_stolen.store(0);
+    m_thread_awake->store(0);
+    m_main_threads.clear();
+    m_stop_threads.clear();
+    m_is_joined.clear();
+    m_is_stopped.clear();
+    m_unique_threads.clear();
+    m_respawn.store(true);
+
+    // the epoll instance is shared with the parent, the child starts without
+    // event sources
+    delete m_event_sources.exchange(nullptr);
+}
+
+//======================================================================================//
+
 ThreadPool::size_type
 ThreadPool::destroy_threadpool()
 {
-    int nid = static_cast<int>(GetThisThreadID());
+    int         nid       = static_cast<int>(GetThisThreadID());
+    ThreadPool* _blocking = m_blocking_pool.load();
+    size_type   _dropped  = 0;
+
+    // the tasks queued or executing, including those of the blocking workers
+    auto _pending = [&]() {
+        bool _busy = (m_task_queue->true_size() > 0 || m_executing.load() > 0);
+        if(_blocking && _blocking->m_alive_flag.load())
+            _busy = _busy || (_blocking->m_task_queue->true_size() > 0 ||
+                              _blocking->m_executing.load() > 0);
+        return _busy;
+    };
+
+    //------------------------------------------------------------------------//
+    // the workers execute the queued tasks (and the tasks those add)
+    if(m_alive_flag.load() && !m_tbb_tp &&
+       (m_shutdown == thread_pool::shutdown::DRAIN ||
+        m_shutdown == thread_pool::shutdown::BOUNDED))
+    {
+        auto _start   = std::chrono::steady_clock::now();
+        auto _elapsed = [&]() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                 _start)
+                .count();
+        };
+        notify_all();
+        while(_pending())
+        {
+            if(m_shutdown == thread_pool::shutdown::BOUNDED &&
+               _elapsed() > m_shutdown_timeout)
+                break;
+            // a LAZY pool drains with all the threads
+            if(m_target_size.load() > m_pool_size)
+                grow();
+            if(_blocking && _blocking->m_target_size.load() > _blocking->m_pool_size)
+                _blocking->grow();
+            ThisThread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
 
     // Note: this is not for synchronization, its for thread communication!
     // destroy_threadpool() will only be called from the main thread, yet
     // the modified m_pool_state may not show up to other threads until its
     // modified in a lock!
     //------------------------------------------------------------------------//
+    // the blocking workers are stopped first, their tasks may wait on this pool
+    if(_blocking && _blocking->m_alive_flag.load())
+    {
+        // what remains was not drained within the timeout
+        if(m_shutdown == thread_pool::shutdown::BOUNDED)
+            _blocking->m_shutdown = thread_pool::shutdown::CANCEL;
+        _dropped += _blocking->destroy_threadpool();
+    }
+
+    // no worker of another pool is executing a task of this pool
+    leave_federation();
+
     m_pool_state.store(thread_pool::state::STOPPED);
+    // wait for a thread being created on demand
+    {
+        AutoLock lock(m_start_lock);
+        m_target_size.store(0);
+    }
 
     //------------------------------------------------------------------------//
     // notify all threads we are shutting down
+    wake_event_poller();
     m_task_lock.lock();
     m_task_cond.notify_all();
     m_task_lock.unlock();
@@ -376,24 +1030,23 @@ ThreadPool::destroy_threadpool()
     //--------------------------------------------------------------------//
     // handle tbb task scheduler
 #ifdef PTL_USE_TBB
-    if(m_tbb_tp && tbb_task_scheduler())
+    if(m_tbb_tp)
     {
-        tbb_task_scheduler_t*& _task_scheduler = tbb_task_scheduler();
-        delete _task_scheduler;
-        _task_scheduler = nullptr;
-        m_tbb_tp        = false;
+        if(m_tbb_task_group)
+        {
+            m_tbb_task_arena->execute([&]() { m_tbb_task_group->wait(); });
+            delete m_tbb_task_group;
+            m_tbb_task_group = nullptr;
+        }
+        delete m_tbb_task_arena;
+        m_tbb_task_arena = nullptr;
+        m_tbb_tp         = false;
         std::cout << "ThreadPool [TBB] destroyed" << std::endl;
     }
-    if(m_tbb_task_group)
-    {
-        m_tbb_task_group->wait();
-        delete m_tbb_task_group;
-        m_tbb_task_group = nullptr;
-    }
 #endif
 
     if(!m_alive_flag.load())
-        return 0;
+        return _dropped;
 
     if(m_is_joined.size() != m_main_threads.size())
     {
@@ -407,14 +1060,19 @@ ThreadPool::destroy_threadpool()
 
     //--------------------------------------------------------------------//
     // erase thread from thread ID list
-    for(auto _tid : m_main_threads)
     {
-        if(f_thread_ids.find(_tid) != f_thread_ids.end())
-            f_thread_ids.erase(f_thread_ids.find(_tid));
+        AutoLock lock(TypeMutex<ThreadPool>());
+        for(auto _tid : m_main_threads)
+        {
+            if(f_thread_ids.find(_tid) != f_thread_ids.end())
+                f_thread_ids.erase(f_thread_ids.find(_tid));
+            m_thread_ids.erase(_tid);
+        }
     }
 
     //--------------------------------------------------------------------//
     // try waking up a bunch of threads that are still waiting
+    wake_event_poller();
     m_task_cond.notify_all();
 
     for(auto& itr : m_unique_threads)
@@ -426,9 +1084,34 @@ ThreadPool::destroy_threadpool()
 
     m_alive_flag.store(false);
 
-    printf("[%i]> ThreadPool destroyed...\n", nid);
+    //--------------------------------------------------------------------//
+    // the tasks still queued are cancelled, none is left in the queue (e.g. the
+    // tasks of a pool without workers with IMMEDIATE)
+    size_type _queued = m_task_queue->true_size();
+    if(_queued > 0)
+    {
+        _queued = 0;
+        while(!m_task_queue->true_empty())
+        {
+            auto _task = m_task_queue->GetTask();
+            if(!_task)
+                break;
+            bool _owned = (_task->group() == nullptr);
+            _task->cancel();
+            if(_owned)
+                delete _task;
+            ++_queued;
+        }
+    }
+    if(_queued > 0)
+    {
+        std::cerr << "[" << nid << "]> ThreadPool cancelled " << _queued
+                  << " queued task(s)" << std::endl;
+    }
+
+    printf("[%i]> ThreadPool %sdestroyed...\n", nid, (m_parent) ? "[blocking] " : "");
 
-    return 0;
+    return _dropped + _queued;
 }
 
 //======================================================================================//
@@ -445,6 +1128,7 @@ ThreadPool::stop_thread()
     m_is_stopped.push_back(true);
     m_task_cond.notify_one();
     m_task_lock.unlock();
+    wake_event_poller();
     //------------------------------------------------------------------------//
 
     // lock up the task queue
@@ -497,14 +1181,27 @@ ThreadPool::execute_thread(VUserTaskQueue* _task_queue)
     assert(data->current_queue != nullptr);
     assert(_task_queue == data->current_queue);
 
+    // with CANCEL and BOUNDED the workers leave the queued tasks to be cancelled
+    // once the pool is stopped, otherwise they empty the queue before they leave
+    auto _cancelled = [&]() {
+        return m_pool_state.load() == thread_pool::state::STOPPED &&
+               (m_shutdown == thread_pool::shutdown::CANCEL ||
+                m_shutdown == thread_pool::shutdown::BOUNDED);
+    };
+
     // essentially a dummy run
     {
         data->within_task = true;
         auto _task        = _task_queue->GetTask();
         if(_task)
         {
+            // a task-group may be joined and destroyed as soon as its last task
+            // finishes so ownership has to be queried before the task is executed
+            bool _owned = (_task->group() == nullptr);
+            ++m_executing;
             (*_task)();
-            if(!_task->group())
+            --m_executing;
+            if(_owned)
                 delete _task;
         }
         data->within_task = false;
@@ -557,13 +1254,32 @@ ThreadPool::execute_thread(VUserTaskQueue* _task_queue)
             auto _state = [&]() { return static_cast<int>(m_pool_state.load()); };
             auto _size  = [&]() { return _task_queue->true_size(); };
             auto _empty = [&]() { return _task_queue->empty(); };
-            auto _wake  = [&]() { return (!_empty() || _size() > 0 || _state() > 0); };
+            auto _wake  = [&]() {
+                return (!_empty() || _size() > 0 || _state() > 0 || m_steal_wake.load() ||
+                        m_poll_wake.load());
+            };
 
             if(leave_pool())
                 return;
 
             if(_task_queue->true_size() == 0)
             {
+                // one idle worker waits on the event sources instead of the
+                // condition and dispatches the ready sources as tasks
+                EventSources* _events = m_event_sources.load();
+                m_poll_wake.store(false);
+                if(_events && _events->poll(_wake))
+                    continue;
+
+                // an idle worker of a federated pool executes the tasks of the
+                // overloaded pools of the federation
+                if(m_federated.load(std::memory_order_relaxed))
+                {
+                    m_steal_wake.store(false);
+                    if(Federation::instance().steal(this))
+                        continue;
+                }
+
                 if(m_thread_awake && m_thread_awake->load() > 0)
                     --(*m_thread_awake);
 
@@ -606,14 +1322,17 @@ ThreadPool::execute_thread(VUserTaskQueue* _task_queue)
         data->within_task = true;
         //----------------------------------------------------------------//
 
-        // execute the task(s)
-        while(!_task_queue->empty())
+        // execute the task(s), with CANCEL and BOUNDED until the pool is stopped
+        while(!_task_queue->empty() && !_cancelled())
         {
             auto _task = _task_queue->GetTask();
             if(_task)
             {
+                bool _owned = (_task->group() == nullptr);
+                ++m_executing;
                 (*_task)();
-                if(!_task->group())
+                --m_executing;
+                if(_owned)
                     delete _task;
             }
         }
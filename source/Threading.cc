@@ -28,6 +28,7 @@
 #include "PTL/Threading.hh"
 #include "PTL/AutoLock.hh"
 #include "PTL/Globals.hh"
+#include "PTL/Utility.hh"
 
 #if defined(WIN32) || defined(_WIN32) || defined(WIN64) || defined(_WIN64)
 #    include <Windows.h>
@@ -37,7 +38,18 @@
 #    include <unistd.h>
 #endif
 
+#if defined(__linux__)
+#    include <sched.h>
+#endif
+
+#include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
 
 //======================================================================================//
 
@@ -66,6 +78,294 @@ Threading::GetNumberOfCores()
 
 //======================================================================================//
 
+#if defined(__linux__)
+
+namespace
+{
+//--------------------------------------------------------------------------------------//
+// parse a cpu list, e.g. "0-3,8,10-11"
+//
+std::vector<int>
+parse_cpu_list(const std::string& _list)
+{
+    std::vector<int>  _cpus;
+    std::stringstream ss(_list);
+    std::string       _range;
+    while(std::getline(ss, _range, ','))
+    {
+        if(_range.find_first_of("0123456789") == std::string::npos)
+            continue;
+        auto _dash  = _range.find('-');
+        int  _first = std::stoi(_range.substr(0, _dash));
+        int  _last  = (_dash == std::string::npos) ? _first
+                                                   : std::stoi(_range.substr(_dash + 1));
+        for(int i = _first; i <= _last; ++i)
+            _cpus.push_back(i);
+    }
+    return _cpus;
+}
+
+//--------------------------------------------------------------------------------------//
+
+bool
+read_line(const std::string& _fname, std::string& _line)
+{
+    std::ifstream ifs(_fname);
+    return ifs && std::getline(ifs, _line) && !_line.empty();
+}
+
+//--------------------------------------------------------------------------------------//
+// the directories of the cgroup of the process, innermost first: for v2
+// ("0::/path") when "_controller" is empty, else for the v1 hierarchy with the
+// controller mounted at /sys/fs/cgroup/<controllers>. In a container the
+// cgroup path may not exist under the mount (cgroup namespace), then the
+// root of the mount is the cgroup of the container
+//
+std::vector<std::string>
+cgroup_dirs(const std::string& _controller)
+{
+    std::vector<std::string> _dirs;
+    std::ifstream            ifs("/proc/self/cgroup");
+    std::string              _line;
+    while(std::getline(ifs, _line))
+    {
+        auto _c0 = _line.find(':');
+        auto _c1 = _line.find(':', _c0 + 1);
+        if(_c0 == std::string::npos || _c1 == std::string::npos)
+            continue;
+        std::string _ctrls = _line.substr(_c0 + 1, _c1 - _c0 - 1);
+        std::string _path  = _line.substr(_c1 + 1);
+
+        std::string _mount;
+        if(_controller.empty())
+        {
+            if(!_ctrls.empty())
+                continue;
+            // unified or hybrid hierarchy
+            _mount = "/sys/fs/cgroup";
+            if(std::ifstream(_mount + "/cgroup.controllers").fail())
+                _mount = "/sys/fs/cgroup/unified";
+        }
+        else
+        {
+            std::stringstream ss(_ctrls);
+            std::string       _ctrl;
+            bool              _found = false;
+            while(std::getline(ss, _ctrl, ','))
+                _found |= (_ctrl == _controller);
+            if(!_found)
+                continue;
+            _mount = "/sys/fs/cgroup/" + _ctrls;
+            if(std::ifstream(_mount + "/cgroup.procs").fail())
+                _mount = "/sys/fs/cgroup/" + _controller;
+        }
+
+        // the limits of the parents apply as well
+        while(!_path.empty() && _path != "/")
+        {
+            if(!std::ifstream(_mount + _path + "/cgroup.procs").fail())
+                _dirs.push_back(_mount + _path);
+            _path = _path.substr(0, _path.find_last_of('/'));
+        }
+        _dirs.push_back(_mount);
+        break;
+    }
+    return _dirs;
+}
+
+//--------------------------------------------------------------------------------------//
+// CPU quota of the cgroup in CPUs, 0 when unlimited
+//
+double
+cgroup_cpu_quota()
+{
+    double      _quota = 0.0;
+    std::string _line;
+    auto        _apply = [&_quota](double _q, double _p) {
+        if(_q > 0.0 && _p > 0.0 && (_quota == 0.0 || _q / _p < _quota))
+            _quota = _q / _p;
+    };
+
+    // v2: "<quota> <period>" or "max <period>"
+    for(const auto& itr : cgroup_dirs(""))
+    {
+        if(!read_line(itr + "/cpu.max", _line) || _line.compare(0, 3, "max") == 0)
+            continue;
+        std::stringstream ss(_line);
+        double            _q = 0.0, _p = 0.0;
+        ss >> _q >> _p;
+        _apply(_q, _p);
+    }
+    if(_quota > 0.0)
+        return _quota;
+
+    // v1: cfs quota of -1 is unlimited
+    for(const auto& itr : cgroup_dirs("cpu"))
+    {
+        std::string _period;
+        if(!read_line(itr + "/cpu.cfs_quota_us", _line) ||
+           !read_line(itr + "/cpu.cfs_period_us", _period))
+            continue;
+        _apply(std::stod(_line), std::stod(_period));
+    }
+    return _quota;
+}
+
+//--------------------------------------------------------------------------------------//
+// cpuset of the cgroup, empty when it cannot be determined
+//
+std::vector<int>
+cgroup_cpuset()
+{
+    std::string _line;
+    for(const auto& itr : cgroup_dirs(""))
+        if(read_line(itr + "/cpuset.cpus.effective", _line))
+            return parse_cpu_list(_line);
+    for(const auto& itr : cgroup_dirs("cpuset"))
+        if(read_line(itr + "/cpuset.effective_cpus", _line) ||
+           read_line(itr + "/cpuset.cpus", _line))
+            return parse_cpu_list(_line);
+    return std::vector<int>();
+}
+}  // namespace
+
+#endif
+
+//======================================================================================//
+
+const std::vector<int>&
+Threading::GetAvailableCpus()
+{
+    static std::vector<int> _instance = []() {
+        std::vector<int> _cpus;
+#if defined(__linux__)
+        cpu_set_t _mask;
+        CPU_ZERO(&_mask);
+        if(sched_getaffinity(0, sizeof(cpu_set_t), &_mask) == 0)
+        {
+            for(int i = 0; i < CPU_SETSIZE; ++i)
+                if(CPU_ISSET(i, &_mask))
+                    _cpus.push_back(i);
+        }
+        try
+        {
+            // normally already part of the affinity mask
+            auto _cpuset = cgroup_cpuset();
+            if(!_cpuset.empty())
+            {
+                std::vector<int> _both;
+                std::set_intersection(_cpus.begin(), _cpus.end(), _cpuset.begin(),
+                                      _cpuset.end(), std::back_inserter(_both));
+                if(!_both.empty())
+                    _cpus = _both;
+            }
+        }
+        catch(std::exception&)
+        {}
+#endif
+        if(_cpus.empty())
+        {
+            for(unsigned i = 0; i < std::max(GetNumberOfCores(), 1u); ++i)
+                _cpus.push_back(static_cast<int>(i));
+        }
+        return _cpus;
+    }();
+    return _instance;
+}
+
+//======================================================================================//
+
+unsigned
+Threading::GetNumberOfAvailableCores()
+{
+    static unsigned _instance = []() {
+        auto _ncpu = static_cast<unsigned>(GetAvailableCpus().size());
+#if defined(__linux__)
+        try
+        {
+            double _quota = cgroup_cpu_quota();
+            if(_quota > 0.0)
+                _ncpu = std::min(_ncpu, static_cast<unsigned>(std::ceil(_quota)));
+        }
+        catch(std::exception&)
+        {}
+#endif
+        if(GetEnv<bool>("PTL_ONE_THREAD_PER_CORE", false))
+        {
+            auto _ncores = static_cast<unsigned>(GetPlacementOrder(true).size());
+            _ncpu        = std::min(_ncpu, _ncores);
+        }
+        return std::max(_ncpu, 1u);
+    }();
+    return _instance;
+}
+
+//======================================================================================//
+
+std::vector<int>
+Threading::GetCpuSiblings(int cpu)
+{
+    std::vector<int> _cpus;
+#if defined(__linux__)
+    std::string _dir  = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology";
+    std::string _line;
+    try
+    {
+        if(read_line(_dir + "/core_cpus_list", _line) ||
+           read_line(_dir + "/thread_siblings_list", _line))
+            _cpus = parse_cpu_list(_line);
+    }
+    catch(std::exception&)
+    {
+        _cpus.clear();
+    }
+#endif
+    if(std::find(_cpus.begin(), _cpus.end(), cpu) == _cpus.end())
+        _cpus = { cpu };
+    return _cpus;
+}
+
+//======================================================================================//
+
+const std::vector<int>&
+Threading::GetPlacementOrder(bool one_per_core)
+{
+    auto _compute = [](bool _one) {
+        // the available logical CPUs of every physical core (in the order of
+        // the first CPU of the core)
+        std::vector<std::vector<int>> _cores;
+        std::map<int, size_t>         _core_index;
+        for(auto itr : GetAvailableCpus())
+        {
+            auto _siblings = GetCpuSiblings(itr);
+            int  _key      = *std::min_element(_siblings.begin(), _siblings.end());
+            if(_core_index.find(_key) == _core_index.end())
+            {
+                _core_index[_key] = _cores.size();
+                _cores.push_back(std::vector<int>());
+            }
+            _cores[_core_index[_key]].push_back(itr);
+        }
+
+        std::vector<int> _order;
+        for(size_t _thread = 0; _order.size() < GetAvailableCpus().size(); ++_thread)
+        {
+            for(const auto& itr : _cores)
+                if(_thread < itr.size())
+                    _order.push_back(itr.at(_thread));
+            if(_one)
+                break;
+        }
+        return _order;
+    };
+
+    static std::vector<int> _all = _compute(false);
+    static std::vector<int> _one = _compute(true);
+    return (one_per_core) ? _one : _all;
+}
+
+//======================================================================================//
+
 void
 Threading::SetThreadId(int value)
 {
@@ -26,6 +26,7 @@
 #include "PTL/UserTaskQueue.hh"
 #include "PTL/Task.hh"
 #include "PTL/TaskGroup.hh"
+#include "PTL/ThreadData.hh"
 #include "PTL/ThreadPool.hh"
 
 #include <cassert>
@@ -35,6 +36,7 @@
 UserTaskQueue::UserTaskQueue(intmax_t nworkers, UserTaskQueue* parent)
 : VUserTaskQueue(nworkers)
 , m_is_clone((parent) ? true : false)
+, m_smt_steal((parent) ? parent->m_smt_steal : GetEnv<bool>("PTL_SMT_STEAL", false))
 , m_thread_bin((parent) ? (ThreadPool::GetThisThreadID() % (nworkers + 1)) : 0)
 , m_insert_bin((parent) ? (ThreadPool::GetThisThreadID() % (nworkers + 1)) : 0)
 , m_hold((parent) ? parent->m_hold : new std::atomic_bool(false))
@@ -119,15 +121,42 @@ UserTaskQueue::clone()
 {
     return new UserTaskQueue(workers(), this);
 }
+
+//======================================================================================//
+
+void
+UserTaskQueue::AcquireClaims()
+{
+    // a claim is only held while a task is pushed or popped
+    for(auto& itr : *m_subqueues)
+    {
+        while(!itr->AcquireClaim())
+            ThisThread::yield();
+    }
+}
+
+//======================================================================================//
+
+void
+UserTaskQueue::ReleaseClaims()
+{
+    for(auto& itr : *m_subqueues)
+        itr->ReleaseClaim();
+}
+
 //======================================================================================//
 
 intmax_t
 UserTaskQueue::GetThreadBin() const
 {
-    // get a thread id number
-    ThreadLocalStatic intmax_t tl_bin =
-        (m_thread_bin + ThreadPool::GetThisThreadID()) % (m_workers + 1);
-    return tl_bin;
+    // the threads of the pool using this queue by their index in the pool
+    auto& _data = ThreadData::GetInstance();
+    if(_data && _data->current_queue == this && _data->thread_index >= 0)
+        return (m_thread_bin + _data->thread_index) % (m_workers + 1);
+
+    // the other threads (e.g. the workers of another pool) by their thread id
+    ThreadLocalStatic intmax_t tl_id = ThreadPool::GetThisThreadID();
+    return (m_thread_bin + tl_id) % (m_workers + 1);
 }
 
 //======================================================================================//
@@ -210,6 +239,24 @@ UserTaskQueue::GetTask(intmax_t subq, intmax_t nitr)
     };
     //------------------------------------------------------------------------//
 
+    // after its own bin, a thread pinned to a CPU looks in the bins of the
+    // threads on the SMT siblings (shared L1/L2) before the other bins
+    if(m_smt_steal && subq < 0)
+    {
+        if(get_task(n))
+            return _task;
+        // the bins of this queue are indexed by the index of the thread in the pool
+        auto& _data = ThreadData::GetInstance();
+        if(_data && _data->current_queue == this && _data->thread_pool)
+        {
+            for(const auto& itr : _data->thread_pool->get_sibling_thread_indices())
+            {
+                if(get_task(m_thread_bin + itr))
+                    return _task;
+            }
+        }
+    }
+
     // there are num_workers+1 bins so there is always a bin that is open
     // execute num_workers+2 iterations so the thread checks its bin twice
     // while(!empty())
@@ -239,7 +286,8 @@ UserTaskQueue::InsertTask(task_pointer task, ThreadData* data, intmax_t subq)
     bool     spin = m_hold->load(std::memory_order_relaxed);
     intmax_t tbin = GetThreadBin();
 
-    if(data && data->within_task)
+    // a task added by a task of this queue stays in the bin of the thread
+    if(data && data->within_task && data->current_queue == this)
     {
         subq = tbin;
         // spin = true;
@@ -93,6 +93,14 @@ VTask::operator--()
 
 //======================================================================================//
 
+void
+VTask::cancel()
+{
+    this_type::operator--();
+}
+
+//======================================================================================//
+
 bool
 VTask::is_native_task() const
 {
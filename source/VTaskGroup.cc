@@ -66,11 +66,17 @@ VTaskGroup::VTaskGroup(ThreadPool* tp)
         std::cerr << __FUNCTION__ << "@" << __LINE__ << " :: Warning! "
                   << "nullptr to thread pool!" << std::endl;
     }
+    else if(m_pool->is_tbb_threadpool())
+        m_tbb_task_group.reset(new tbb_task_group_t());
 }
 
 //======================================================================================//
 
-VTaskGroup::~VTaskGroup() {}
+VTaskGroup::~VTaskGroup()
+{
+    if(m_tbb_task_group)
+        m_tbb_task_group->wait();
+}
 
 //======================================================================================//
 
@@ -98,6 +104,14 @@ VTaskGroup::wait()
         }
     }
 
+    // TBB: the thread takes part in the execution of the tasks in the arena of
+    // the pool until those of this task-group have completed
+    if(m_tbb_task_group && m_pool->get_task_arena())
+    {
+        m_pool->get_task_arena()->execute([&]() { m_tbb_task_group->wait(); });
+        return;
+    }
+
     auto& data = ThreadData::GetInstance();
     if(!data)
         return;
@@ -162,6 +176,11 @@ VTaskGroup::wait()
         }
     }
 
+    // a thread of another pool executes the tasks in the context of this pool
+    bool _other_pool = (tpool && tpool != data->thread_pool);
+    if(_other_pool)
+        data->push(tpool);
+
     intmax_t wake_size = 2;
     AutoLock _lock(m_task_lock, std::defer_lock);
 
@@ -203,6 +222,9 @@ VTaskGroup::wait()
     if(_lock.owns_lock())
         _lock.unlock();
 
+    if(_other_pool)
+        data->pop();
+
     intmax_t ntask = this->task_count().load();
     if(ntask > 0)
     {